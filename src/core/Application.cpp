@@ -3,12 +3,55 @@
 
 namespace PT 
 {
-	Application::Application() : m_running(false), m_spp(0), m_window(nullptr) {}
+	namespace
+	{
+		// Quoted JSON string, paths may hold backslashes on Windows
+		std::string JSONString(const std::string& value)
+		{
+			std::string quoted = "\"";
+			for (const char& c : value)
+			{
+				if (c == '"' || c == '\\')
+				{
+					quoted += '\\';
+					quoted += c;
+				}
+				else if (static_cast<unsigned char>(c) < 0x20)
+				{
+					const char* hex = "0123456789abcdef";
+					quoted += "\\u00";
+					quoted += hex[c >> 4];
+					quoted += hex[c & 0xF];
+				}
+				else
+					quoted += c;
+			}
+			return quoted + "\"";
+		}
+	}
 
-	void Application::Init()
+	Application::Application() : m_running(false), m_spp(0), m_window(nullptr), m_traceFramesLeft(0) {}
+
+	void Application::Init(const Settings& settings)
 	{
 		LOG_INFO("Initializing Application...\n");
 
+		m_settings = settings;
+		const bool headless = settings.headlessSettings.enabled;
+		if (m_settings.profilerSettings.traceStartup)
+		{
+			m_traceFile = "startup_trace.json";
+			Trace::BeginCapture();
+		}
+
+		PROFILE_FUNCTION();
+
+#ifdef GLFW_PLATFORM_NULL
+		// EGL and OSMesa contexts need no display server, GLFW 3.4 can then run without one
+		if (headless && settings.headlessSettings.contextAPI != ContextAPI::Native)
+			glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+
 		// Initialize GLFW
 		if (!glfwInit()) 
 		{
@@ -21,15 +64,22 @@ namespace PT
 		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-		// Read settings
-		Settings settings;
+		// A headless render keeps its window hidden, it only provides the context
+		if (headless)
+		{
+			glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+			if (settings.headlessSettings.contextAPI == ContextAPI::EGL)
+				glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+			else if (settings.headlessSettings.contextAPI == ContextAPI::OSMesa)
+				glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+		}
 
 		// Create a GLFW window
 		try 
 		{
 			m_window = new Window("Path Tracer", settings.videoSettings.width, settings.videoSettings.height);
 		}
-		catch (const std::string errmsg)
+		catch (const char* errmsg)
 		{
 			LOG_CRITICAL(errmsg); 
 			exit(-1);
@@ -42,17 +92,30 @@ namespace PT
 			exit(-1);
 		}
 
-		Input::Init(settings, *m_window);
+		if (!headless)
+		{
+			glfwSwapInterval(settings.videoSettings.vsync ? 1 : 0);
+			Input::Init(settings, *m_window);
+		}
 		Renderer::Init(settings, *m_window);
+		m_scheduler.Init(settings.schedulerSettings);
+		m_frameStats.Init(m_settings.profilerSettings.reportInterval);
 
 		SetEventCallback(EventType::CloseApp, [&](Event* e) { OnEvent(e); });
 		SetEventCallback(EventType::ResetAccumulator, [&](Event* e) { OnEvent(e); });
+		SetEventCallback(EventType::CaptureTrace, [&](Event* e) { OnEvent(e); });
 
 		LOG_INFO("Application initialized successfully!\n");
 	}
 
 	void Application::Run()
 	{
+		if (m_settings.headlessSettings.enabled)
+		{
+			RunHeadless();
+			return;
+		}
+
 		float currentTime = 0.0;
 		float lastTime = 0.0;
 		float delta_t = 0.0;
@@ -60,27 +123,174 @@ namespace PT
 
 		while (m_running)
 		{
+			UpdateTraceCapture();
+
+			PROFILE_SCOPE("Frame");
 			currentTime = glfwGetTime();
 			delta_t = currentTime - lastTime;
 			lastTime = currentTime;
 
 			Input::Update(delta_t);
-			Renderer::Update();
-			m_window->UpdateTitle(uint32_t(1.0 / delta_t), m_spp++);
 
-			glfwPollEvents();
-			glfwSwapBuffers(*m_window);
+			// Accumulate as many batches as the frame budget allows, then present once.
+			// A converged image takes no more batches until the accumulator is reset.
+			uint32_t nBatches = Renderer::IsConverged() ? 0 : m_scheduler.GetBatchCount(Renderer::GetBatchTime());
+			Renderer::BeginFrame();
+			for (uint32_t i = 0; i < nBatches; ++i)
+				Renderer::Render();
+			Renderer::Present();
+
+			m_spp += nBatches * Renderer::GetSamplesPerPixel();
+			m_window->UpdateTitle(uint32_t(1.0 / delta_t), m_spp, Renderer::GetProfilerOverlay());
+
+			{
+				PROFILE_SCOPE("PollEvents");
+				if (Renderer::IsConverged())
+					glfwWaitEventsTimeout(0.1);
+				else
+					glfwPollEvents();
+			}
+			{
+				PROFILE_SCOPE("SwapBuffers");
+				glfwSwapBuffers(*m_window);
+			}
+
+			if (Trace::IsCapturing() && m_traceFramesLeft > 0)
+				--m_traceFramesLeft;
+
+			double frameTime = glfwGetTime() - currentTime;
+			m_frameStats.RecordFrame(frameTime * 1000.0, frameTime > 0.0 ? double(Renderer::GetFrameSamples()) / frameTime : 0.0);
 		}
+
+		m_traceFramesLeft = 0;
+		UpdateTraceCapture();
 	}
 
 	void Application::Shutdown()
 	{
 		LOG_INFO("Shutting down Application...\n");
+
+		std::error_code error;
+		std::filesystem::create_directories(m_settings.profilerSettings.outputPath, error);
+		m_frameStats.LogSummary();
+		m_frameStats.WriteCSV(m_settings.profilerSettings.outputPath + "frame_stats.csv");
+
 		Renderer::Shutdown();
 		delete (m_window);
 		LOG_INFO("Application shutted down successfully!\n");
 	}
 
+	void Application::RunHeadless()
+	{
+		// Ends the startup capture, frames are not traced headless
+		UpdateTraceCapture();
+
+		const HeadlessSettings& headless = m_settings.headlessSettings;
+		std::string limits;
+		if (headless.samplesPerPixel > 0)
+			limits += " up to " + std::to_string(headless.samplesPerPixel) + " spp";
+		if (headless.timeLimit > 0.0)
+			limits += (limits.empty() ? " for " : " or ") + std::to_string(headless.timeLimit) + " s";
+		LOG_INFO("Rendering ", m_settings.renderSettings.scenePath, " headless", limits, "\n");
+
+		Histogram batchTimes(1e-2, 1e5);
+		GLsync batchFences[HEADLESS_BATCHES_IN_FLIGHT]{};
+		uint32_t nBatches = 0;
+		uint64_t nSamples = 0;
+
+		const double startTime = glfwGetTime();
+		double lastTime = startTime;
+		while (!Renderer::IsConverged())
+		{
+			if (headless.samplesPerPixel > 0 && m_spp >= headless.samplesPerPixel)
+				break;
+			if (headless.timeLimit > 0.0 && lastTime - startTime >= headless.timeLimit)
+				break;
+
+			// Nothing presents to pace the loop, so wait for older batches before queuing more. The time
+			// limit then follows what the GPU has rendered rather than what was submitted.
+			GLsync& fence = batchFences[nBatches % HEADLESS_BATCHES_IN_FLIGHT];
+			if (fence)
+			{
+				glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+				glDeleteSync(fence);
+			}
+
+			Renderer::BeginFrame();
+			Renderer::Render();
+			fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+			m_spp += Renderer::GetSamplesPerPixel();
+			nSamples += Renderer::GetFrameSamples();
+			++nBatches;
+
+			const double currentTime = glfwGetTime();
+			const double batchTime = currentTime - lastTime;
+			batchTimes.Record(batchTime * 1000.0);
+			m_frameStats.RecordFrame(batchTime * 1000.0, batchTime > 0.0 ? double(Renderer::GetFrameSamples()) / batchTime : 0.0);
+			lastTime = currentTime;
+		}
+
+		glFinish();
+		for (GLsync& fence : batchFences)
+			if (fence)
+				glDeleteSync(fence);
+		const double renderTime = glfwGetTime() - startTime;
+
+		LOG_INFO("Rendered ", m_spp, " spp in ", nBatches, " batches and ", renderTime, " s\n");
+		Renderer::SaveImage(headless.outputName);
+		WriteRenderStats(nBatches, nSamples, renderTime, batchTimes);
+	}
+
+	void Application::WriteRenderStats(const uint32_t& nBatches, const uint64_t& nSamples, const double& renderTime, const Histogram& batchTimes) const
+	{
+		const HeadlessSettings& headless = m_settings.headlessSettings;
+		const std::string image = m_settings.captureSettings.outputPath + headless.outputName + ImageIO::GetExtension(m_settings.captureSettings.format);
+		const std::string path = headless.statsPath.empty() ? m_settings.captureSettings.outputPath + headless.outputName + ".json" : headless.statsPath;
+
+		std::error_code error;
+		if (std::filesystem::path(path).has_parent_path())
+			std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+		std::ofstream file(path);
+		if (!file.is_open())
+		{
+			LOG_WARNING("Failed to write the render statistics to: ", path, "\n");
+			return;
+		}
+
+		const uint32_t width  = m_settings.renderSettings.width  ? m_settings.renderSettings.width  : m_settings.videoSettings.width;
+		const uint32_t height = m_settings.renderSettings.height ? m_settings.renderSettings.height : m_settings.videoSettings.height;
+		file << "{\n\t\"scene\": " << JSONString(m_settings.renderSettings.scenePath) << ",\n\t\"image\": " << JSONString(image) << ",\n"
+			 << "\t\"width\": " << width << ",\n\t\"height\": " << height << ",\n"
+			 << "\t\"samples_per_pixel\": " << m_spp << ",\n\t\"batches\": " << nBatches << ",\n"
+			 << "\t\"render_time_s\": " << renderTime << ",\n"
+			 << "\t\"samples_per_second\": " << (renderTime > 0.0 ? double(nSamples) / renderTime : 0.0) << ",\n"
+			 << "\t\"batch_ms\": { \"min\": " << batchTimes.GetMin() << ", \"avg\": " << batchTimes.GetMean()
+			 << ", \"p50\": " << batchTimes.GetPercentile(50.0) << ", \"p90\": " << batchTimes.GetPercentile(90.0)
+			 << ", \"p99\": " << batchTimes.GetPercentile(99.0) << ", \"max\": " << batchTimes.GetMax() << " },\n"
+			 << "\t\"gpu_memory_mb\": " << double(GPUMemory::GetTotal()) / (1024.0 * 1024.0) << "\n}\n";
+
+		LOG_INFO("Render statistics written to ", path, "\n");
+	}
+
+	void Application::UpdateTraceCapture()
+	{
+		// Captures start and end between frames so every zone they hold is closed, the startup
+		// capture ends before the first frame
+		if (Trace::IsCapturing() && m_traceFramesLeft == 0)
+		{
+			std::error_code error;
+			std::filesystem::create_directories(m_settings.profilerSettings.outputPath, error);
+			Trace::EndCapture(m_settings.profilerSettings.outputPath + m_traceFile);
+		}
+		else if (!Trace::IsCapturing() && m_traceFramesLeft > 0)
+		{
+			m_traceFile = "frame_trace.json";
+			Trace::BeginCapture();
+		}
+	}
+
 	void Application::OnEvent(Event* e)
 	{
 		switch (e->type)
@@ -91,6 +301,14 @@ namespace PT
 				break;
 			case EventType::ResetAccumulator:
 				m_spp = 0;
+				m_scheduler.OnInteraction(static_cast<ResetAccumulatorEvent*>(e)->time);
+				break;
+			case EventType::CaptureTrace:
+				if (m_traceFramesLeft == 0)
+				{
+					LOG_INFO("Capturing a trace of the next ", m_settings.profilerSettings.traceFrames, " frame(s)...\n");
+					m_traceFramesLeft = std::max<uint32_t>(1, m_settings.profilerSettings.traceFrames);
+				}
 				break;
 			default:
 				LOG_WARNING("Application does not support this kind of event!\n");
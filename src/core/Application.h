@@ -5,6 +5,11 @@
 #include "Settings.h"
 #include "Input.h"
 #include "Renderer.h"
+#include "Scheduler.h"
+#include "ImageIO.h"
+
+// Batches a headless render queues ahead of the GPU
+#define HEADLESS_BATCHES_IN_FLIGHT 2
 
 namespace PT
 {
@@ -13,15 +18,26 @@ namespace PT
 		public:
 			explicit Application();
 
-			void Init();
+			void Init(const Settings& settings);
 			void Run();
 			void Shutdown();
 
 			void OnEvent(Event* e);
 
 		private:
+			void UpdateTraceCapture();
+			// Renders without presenting until the headless limits are reached, then saves the image
+			void RunHeadless();
+			void WriteRenderStats(const uint32_t& nBatches, const uint64_t& nSamples, const double& renderTime, const Histogram& batchTimes) const;
+
 			bool m_running;
 			uint32_t m_spp;
 			Window* m_window;
+			FrameScheduler m_scheduler;
+
+			Settings m_settings;
+			FrameStatistics m_frameStats;
+			uint32_t m_traceFramesLeft;
+			std::string m_traceFile;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,277 @@
+#include <PT.h>
+#include "BVH.h"
+
+namespace PT
+{
+	glm::vec3 Bounds::Diagonal() const
+	{
+		return glm::clamp(max - min, 0.0f, std::numeric_limits<float>::max());
+	}
+
+	float Bounds::SurfaceArea() const
+	{
+		glm::vec3 d = Diagonal();
+		return 2.0f * (d.x * d.y + d.x * d.z + d.y * d.z);
+	}
+
+	void Bounds::Union(const Bounds& other)
+	{
+		this->min = glm::vec3(std::min(this->min.x, other.min.x),
+							  std::min(this->min.y, other.min.y),
+							  std::min(this->min.z, other.min.z));
+
+		this->max = glm::vec3(std::max(this->max.x, other.max.x),
+							  std::max(this->max.y, other.max.y),
+							  std::max(this->max.z, other.max.z));
+	}
+
+	BVHNode::BVHNode(std::vector<Primitive>& t_primitives) : depth(0),
+						 nChild(0),
+						 isLeaf(true), 
+						 left(nullptr), 
+						 right(nullptr) 
+	{
+		
+		for (uint32_t i = 0; i < t_primitives.size(); ++i)
+		{
+			this->primitives.push_back(&t_primitives[i]);
+		}
+	}
+
+	BVHNode::BVHNode(uint32_t&& t_depth) : depth(t_depth),
+										   nChild(0),
+										   isLeaf(true),
+										   left(nullptr),
+										   right(nullptr) {}
+
+	BVHNode::~BVHNode()
+	{
+		if (this->left)
+			delete(this->left);
+		if (this->right) 
+			delete(this->right);
+	}
+
+	void BVHNode::FindBounds()
+	{
+		for (Primitive* i : primitives)
+		{
+			this->bounds.Union(i->bounds);
+		}
+	}
+
+	void BVHNode::Subdivide()
+	{
+		if (this->primitives.size() <= minPrimitives)
+			return;
+
+		this->left = new BVHNode(this->depth + 1);
+		this->right = new BVHNode(this->depth + 1);
+
+		this->nChild += 2;
+
+		Partition();
+
+		// Empty child, so this node couldn't be partitioned any further. Return it as a leaf instead
+		if (this->left->primitives.size() == 0 || this->right->primitives.size() == 0)
+		{
+			this->nChild = 0;
+			delete(this->left);
+			delete(this->right);
+			this->left = nullptr;
+			this->right = nullptr;
+			return;
+		}
+
+		this->left->FindBounds();
+		this->right->FindBounds();
+
+		this->left->Subdivide();
+		this->right->Subdivide();
+
+		this->nChild += left->nChild + right->nChild;
+		this->isLeaf = false;
+	}
+
+	void BVHNode::Partition()
+	{
+		std::vector<Primitive*>::iterator ptr = SAHSplit();
+
+		for (auto i = this->primitives.begin(); i < ptr; ++i)
+		{
+			this->left->primitives.emplace_back(*i);
+		}
+
+		for (auto i = ptr; i != this->primitives.end(); ++i)
+		{
+			this->right->primitives.emplace_back(*i);
+		}
+	}
+
+
+	GPUBVHNode::GPUBVHNode(const BVHNode* node, uint32_t& n, const uint32_t& idx) : nPrimitives(0), _pad{ 0, 0, 0 }
+	{
+		this->boundMin = node->bounds.min;
+		this->boundMax = node->bounds.max;
+
+		// Subtrees are contiguous in preorder, nChild counts every node below this one
+		this->escapeOffset = idx + node->nChild + 1;
+	
+		// Leaf node
+		if (node->isLeaf)
+		{
+			this->secondChildOffset = n;
+			this->nPrimitives = node->primitives.size();
+			n += this->nPrimitives;
+		}
+		// Parent node
+		else
+		{
+			this->secondChildOffset = idx + node->left->nChild + 2;
+			this->nPrimitives = 0;
+		}
+	}
+
+	glm::vec3 BVHNode::Offset(const glm::vec3& point) const
+	{
+		glm::vec3 offset = point - this->bounds.min;
+
+		if (this->bounds.max.x >= point.x)
+			offset.x /= this->bounds.max.x - this->bounds.min.x;
+		if (this->bounds.max.y >= point.y)
+			offset.y /= this->bounds.max.y - this->bounds.min.y;
+		if (this->bounds.max.z >= point.z)
+			offset.z /= this->bounds.max.z - this->bounds.min.z;
+
+		return offset;
+	}
+
+	// As per PBR Book - Chapter 4.3
+	std::vector<Primitive*>::iterator BVHNode::SAHSplit()
+	{
+		const size_t naxis = 3;
+		const size_t nbins = 16;
+
+		struct Bin
+		{
+			uint32_t count = 0;
+			Bounds bounds;
+		} bins[naxis][nbins];
+
+		// See where each primitive lands on each bin
+		for (size_t axis = 0; axis < naxis; ++axis) 
+		{
+			for (Primitive* i : this->primitives)
+			{
+				uint32_t bidx = uint32_t(nbins * Offset(i->centroid)[axis]);
+
+				if (bidx == nbins)
+					bidx = nbins - 1;
+
+				bins[axis][bidx].count++;
+				bins[axis][bidx].bounds.Union(i->bounds);
+			}
+		}
+
+		// Calculate all bins costs
+		float cost[naxis][nbins - 1];
+
+		for (size_t axis = 0; axis < naxis; ++axis)
+		{
+			for (size_t i = 0; i < nbins - 1; ++i)
+			{
+				Bounds lower, upper;
+				uint32_t countLower = 0;
+				uint32_t countUpper = 0;
+
+				for (size_t j = 0; j <= i; ++j)
+				{
+					lower.Union(bins[axis][j].bounds);
+					countLower += bins[axis][j].count;
+				}
+
+				for (size_t j = i + 1; j < nbins; ++j)
+				{
+					upper.Union(bins[axis][j].bounds);
+					countUpper += bins[axis][j].count;
+				}
+
+				cost[axis][i] = 0.125f + (countLower * lower.SurfaceArea() + countUpper * upper.SurfaceArea()) / this->bounds.SurfaceArea();
+			}
+		}
+
+		// Find the split with the minimum cost
+		float minCost = cost[0][0];
+		size_t minCostSplitBin = 0, minCostAxis = 0;
+
+		for (size_t axis = 0; axis < naxis; ++axis)
+		{
+			for (size_t i = 1; i < nbins - 1; ++i)
+			{
+				if (cost[axis][i] < minCost)
+				{
+					minCost = cost[axis][i];
+					minCostSplitBin = i;
+					minCostAxis = axis;
+				}
+			}
+		}
+
+		// Rearrange primitives according to the best split
+		std::vector<Primitive*>::iterator ptr;
+		float leafCost = float(this->primitives.size());
+
+		// Splitting is not worth it, just turn this node into a leaf
+		if (leafCost < minCost && this->primitives.size() > minPrimitives)
+			ptr = this->primitives.end();
+		// Split this node
+		else
+			ptr = std::partition(this->primitives.begin(), this->primitives.end(), [&](Primitive* t)
+				{
+					uint32_t bidx = uint32_t(nbins * Offset(t->centroid)[minCostAxis]);
+					
+					if (bidx == nbins)
+						bidx = nbins - 1;
+
+					return bidx <= minCostSplitBin;
+				});
+
+		return ptr;
+	}
+
+	void BuildFlatBVH(std::vector<Primitive>& primitives, std::vector<GPUBVHNode>& nodes, std::vector<const Primitive*>& order)
+	{
+		// Host side BVH
+		BVHNode* root = new BVHNode(primitives);
+		root->FindBounds();
+		root->Subdivide();
+		
+		// Convert it to a linear layout for GPU traversal
+		std::stack<BVHNode*> visited;
+		visited.push(root);
+		uint32_t n = 0;
+		uint32_t ind = 0;
+
+		while (!visited.empty())
+		{
+			BVHNode* current = visited.top();
+			nodes.emplace_back(std::move(GPUBVHNode(current, n, ind++)));
+			visited.pop();
+
+			if (current->right)
+				visited.push(current->right);
+			if (current->left)
+				visited.push(current->left);
+
+			if (current->isLeaf)
+			{
+				for (const Primitive* i : current->primitives)
+				{
+					order.emplace_back(i);
+				}
+			}
+		}
+
+		delete root;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+#include "Logger.h"
+
+namespace PT
+{
+	struct Bounds
+	{
+		glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+		glm::vec3 Diagonal() const;
+		float SurfaceArea() const;
+		void Union(const Bounds& other);
+	};
+
+	enum class PrimitiveType : uint32_t { Triangle, Sphere, SphereLight };
+
+	// Leaves reference their primitives by index and type, packed as type << PRIMITIVE_TYPE_SHIFT | index
+	constexpr uint32_t PRIMITIVE_TYPE_SHIFT = 30;
+
+	// What the BVH builder sees of a primitive, index points into the owner's array of that type
+	struct Primitive
+	{
+		Bounds bounds;
+		glm::vec3 centroid = glm::vec3(0.0f);
+		PrimitiveType type = PrimitiveType::Triangle;
+		uint32_t index	   = 0;
+	};
+
+	enum class SplitAxis { X, Y, Z };
+	
+	constexpr uint32_t minPrimitives = 2;
+
+	class BVHNode
+	{
+		public:
+			BVHNode(std::vector<Primitive>& t_primitives);
+			BVHNode(uint32_t&& t_depth);
+			~BVHNode();
+
+			void FindBounds();
+			void Subdivide();
+			void Partition();
+
+		public:
+			bool isLeaf;
+			uint32_t depth;
+			uint32_t nChild;
+			Bounds bounds;
+			std::vector<Primitive*> primitives;
+			BVHNode* left;
+			BVHNode* right;
+
+		private:
+			glm::vec3 Offset(const glm::vec3& point) const;
+			std::vector<Primitive*>::iterator SAHSplit();
+	};
+
+	struct alignas(16) GPUBVHNode
+	{
+		explicit GPUBVHNode(const BVHNode * node, uint32_t & n, const uint32_t & idx);
+
+		alignas(16) glm::vec3 boundMin;
+		alignas(4)  uint32_t secondChildOffset;
+		alignas(16) glm::vec3 boundMax;
+		alignas(4)  uint32_t nPrimitives;
+
+		// Next node in preorder once this subtree is done or skipped, the node count past the last subtree
+		alignas(16) uint32_t escapeOffset;
+		alignas(4)  uint32_t _pad[3];
+	};
+
+	// Builds a BVH over the primitives and flattens it in preorder for GPU traversal.
+	// order receives the primitives in the order the leaves reference them.
+	void BuildFlatBVH(std::vector<Primitive>& primitives, std::vector<GPUBVHNode>& nodes, std::vector<const Primitive*>& order);
+}
\ No newline at end of file
@@ -27,15 +27,70 @@ namespace PT
 		glBindVertexArray(0);
 	}
 
+	namespace
+	{
+		// Appends an array of n elements to a std430 block of the given size, the array starts at its element's alignment
+		template<typename T>
+		size_t AppendStd430Array(const size_t& size, const uint32_t& n)
+		{
+			return (size + alignof(T) - 1) / alignof(T) * alignof(T) + sizeof(T) * n;
+		}
+
+		std::string BufferUsage(const uint32_t& type, const uint32_t& storageType)
+		{
+			std::string usage;
+			switch (type)
+			{
+				case GL_SHADER_STORAGE_BUFFER:	  usage = "SSBO"; break;
+				case GL_UNIFORM_BUFFER:			  usage = "UBO"; break;
+				case GL_DISPATCH_INDIRECT_BUFFER: usage = "indirect"; break;
+				case GL_COPY_WRITE_BUFFER:		  usage = "readback"; break;
+				default:						  usage = "buffer"; break;
+			}
+
+			switch (storageType)
+			{
+				case GL_STATIC_DRAW:  return usage + ", static";
+				case GL_DYNAMIC_DRAW: return usage + ", dynamic";
+				case GL_STREAM_READ:  return usage + ", stream read";
+				default:			  return usage;
+			}
+		}
+	}
+
+	size_t GetPathBufferSize(const uint32_t& nPaths)
+	{
+		size_t size = 0;
+		size = AppendStd430Array<Std430Vec3>(size, nPaths);		// throughput
+		size = AppendStd430Array<Std430Vec3>(size, nPaths);		// radiance
+		size = AppendStd430Array<float>(size, nPaths);			// mediumIOR
+		size = AppendStd430Array<uint32_t>(size, nPaths);		// pixel
+		size = AppendStd430Array<uint32_t>(size, nPaths);		// depth
+		size = AppendStd430Array<uint32_t>(size, nPaths);		// sampleIdx
+		size = AppendStd430Array<LightSampleRec>(size, nPaths);	// lightSampleRec
+		return size;
+	}
+
 	GLBuffer::~GLBuffer()
 	{
+		// Deleting a buffer also unmaps it
 		glDeleteBuffers(1, &m_id);
+		GPUMemory::Free(m_allocation);
 	}
 
-	void GLBuffer::InitBuffer(const uint32_t& type, const uint32_t& storageType)
+	void GLBuffer::InitBuffer(const uint32_t& type, const uint32_t& storageType, const std::string& name, const std::string& subsystem)
 	{
+		// Initializing again, e.g. when a scene is reloaded, replaces the previous buffer instead of leaking it
+		if (m_id)
+			glDeleteBuffers(1, &m_id);
+		GPUMemory::Free(m_allocation);
+		m_allocation = GPU_NO_ALLOCATION;
+		m_mapped = nullptr;
+
 		m_type = type;
 		m_storageType = storageType;
+		m_name = name;
+		m_subsystem = subsystem;
 		glGenBuffers(1, &m_id);
 	}
 
@@ -55,5 +110,138 @@ namespace PT
 		glBufferData(m_type, size * n, nullptr, m_storageType);
 		glBindBufferBase(m_type, bufferIndex, m_id);
 		Unbind();
+		TrackAllocation(size * n, BufferUsage(m_type, m_storageType));
+	}
+
+	void GLBuffer::InitData(const size_t& size, const uint32_t&& n)
+	{
+		Bind();
+		glBufferData(m_type, size * n, nullptr, m_storageType);
+		Unbind();
+		TrackAllocation(size * n, BufferUsage(m_type, m_storageType));
+	}
+
+	void GLBuffer::InitStorage(const size_t& size, const uint32_t&& n, const uint32_t&& flags)
+	{
+		if (!HasBufferStorage())
+		{
+			InitData(size, std::forward<const uint32_t>(n));
+			return;
+		}
+
+		Bind();
+		glBufferStorage(m_type, size * n, nullptr, flags);
+		if (flags & GL_MAP_PERSISTENT_BIT)
+			m_mapped = static_cast<uint8_t*>(glMapBufferRange(m_type, 0, size * n, flags & (GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT)));
+		Unbind();
+		TrackAllocation(size * n, BufferUsage(m_type, 0) + (m_mapped ? ", persistent" : ", immutable"));
+	}
+
+	void GLBuffer::ClearData()
+	{
+		Bind();
+		glClearBufferData(m_type, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+		Unbind();
+	}
+
+	void GLBuffer::ClearData(const uint32_t& value, const size_t& offset, const size_t& size)
+	{
+		glClearBufferSubData(m_type, GL_R32UI, offset, size, GL_RED_INTEGER, GL_UNSIGNED_INT, &value);
+	}
+
+	void GLBuffer::BindRange(const uint32_t& bufferIndex, const size_t& offset, const size_t& size)
+	{
+		glBindBufferRange(m_type, bufferIndex, m_id, offset, size);
+	}
+
+	void GLBuffer::SetUsedBytes(const size_t& used)
+	{
+		GPUMemory::SetUsed(m_allocation, used);
+	}
+
+	uint8_t* GLBuffer::GetMappedData() const
+	{
+		return m_mapped;
+	}
+
+	bool GLBuffer::HasBufferStorage()
+	{
+		static const bool supported = glBufferStorage != nullptr &&
+			(GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4) || glfwExtensionSupported("GL_ARB_buffer_storage"));
+		return supported;
+	}
+
+	void GLBuffer::TrackAllocation(const size_t& size, const std::string& usage)
+	{
+		if (m_allocation == GPU_NO_ALLOCATION)
+			m_allocation = GPUMemory::Allocate(m_name, m_subsystem, usage, size);
+		else
+			GPUMemory::Resize(m_allocation, size);
+	}
+
+	RingBuffer::~RingBuffer()
+	{
+		for (GLsync& fence : m_fences)
+			if (fence)
+				glDeleteSync(fence);
+	}
+
+	void RingBuffer::Init(const uint32_t& type, const size_t& segmentSize, const uint32_t& nSegments, const std::string& name, const std::string& subsystem)
+	{
+		GLint alignment = 1;
+		if (type == GL_UNIFORM_BUFFER)
+			glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		else if (type == GL_SHADER_STORAGE_BUFFER)
+			glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		m_alignment = size_t(std::max(alignment, 1));
+
+		m_type = type;
+		m_segmentSize = segmentSize;
+		m_fences.assign(nSegments, nullptr);
+		m_head = 0;
+		m_segment = 0;
+
+		m_buffer.InitBuffer(type, GL_DYNAMIC_DRAW, name, subsystem);
+		m_buffer.InitStorage(segmentSize, std::forward<const uint32_t>(nSegments), GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+		if (!m_buffer.GetMappedData())
+			LOG_WARNING("Persistent buffer mapping is unavailable, ", name, " falls back to glBufferSubData.\n");
+	}
+
+	size_t RingBuffer::Allocate(const size_t& size)
+	{
+		size_t offset = (m_head + m_alignment - 1) / m_alignment * m_alignment;
+		if (offset + size > m_segmentSize)
+		{
+			// Every command reading the segment has been issued, fence it and move on to the oldest one
+			m_fences[m_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			m_segment = (m_segment + 1) % uint32_t(m_fences.size());
+			offset = 0;
+
+			if (GLsync fence = m_fences[m_segment])
+			{
+				// Normally signaled long ago, only a GPU several segments behind makes this wait
+				GLenum status = GL_TIMEOUT_EXPIRED;
+				while (status == GL_TIMEOUT_EXPIRED)
+					status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+				glDeleteSync(fence);
+				m_fences[m_segment] = nullptr;
+			}
+		}
+
+		m_head = offset + size;
+		return m_segment * m_segmentSize + offset;
+	}
+
+	void RingBuffer::Write(const void* data, const size_t& offset, const size_t& size)
+	{
+		if (uint8_t* mapped = m_buffer.GetMappedData())
+		{
+			std::memcpy(mapped + offset, data, size);
+			return;
+		}
+
+		m_buffer.Bind();
+		glBufferSubData(m_type, offset, size, data);
+		m_buffer.Unbind();
 	}
 }
\ No newline at end of file
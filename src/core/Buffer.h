@@ -1,7 +1,7 @@
 #pragma once
+#include "GPUMemory.h"
+
 #define MIN_WORK_GROUP_INVOCATION_X	1024
-#define MAX_WIDTH   1920
-#define MAX_HEIGHT  1080
 #define MAX_BOUNCES 8
 
 #define UNIFORM_BUFFER_BINDING_INDEX   0
@@ -13,6 +13,22 @@
 #define HIT_BUFFER_BINDING_INDEX	   6
 #define PATH_BUFFER_BINDING_INDEX	   7
 #define SCENE_BUFFER_BINDING_INDEX	   8
+#define SPLAT_BUFFER_BINDING_INDEX	   9
+#define ACTIVE_BUFFER_BINDING_INDEX	   10
+#define ENVIRONMENT_BUFFER_BINDING_INDEX 11
+#define SPHERE_LIGHT_BUFFER_BINDING_INDEX 12
+#define LIGHT_NODE_BUFFER_BINDING_INDEX  13
+#define LIGHT_ENTRY_BUFFER_BINDING_INDEX 14
+#define TRIANGLE_LIGHT_BUFFER_BINDING_INDEX 15
+#define SPHERE_BUFFER_BINDING_INDEX		 16
+#define ANALYTIC_NODE_BUFFER_BINDING_INDEX 17
+#define ANALYTIC_PRIMITIVE_BUFFER_BINDING_INDEX 18
+#define STATS_BUFFER_BINDING_INDEX		 19
+
+// Per-frame uploads are written into segments of a persistently mapped ring, a segment is reused once the fence
+// placed after its last use has signaled
+#define UPLOAD_RING_SEGMENT_SIZE	65536
+#define UPLOAD_RING_SEGMENTS		4
 
 namespace PT
 {
@@ -26,6 +42,8 @@ namespace PT
 		alignas(4) uint32_t extendThreadCounter;
 		alignas(4) uint32_t shadeThreadCounter;
 		alignas(4) uint32_t connectThreadCounter;
+		alignas(4) uint32_t sampleCounter;
+		alignas(4) uint32_t traceWorkGroup;
 	};
 
 	struct Uniforms
@@ -39,48 +57,45 @@ namespace PT
 		alignas(4) uint32_t nSpheres;
 		alignas(4) uint32_t nModels;
 		alignas(4) uint32_t frame;
+		alignas(4) uint32_t tileOffset;
+		alignas(4) uint32_t tileSize;
+		alignas(4) uint32_t samplesPerPixel;
+		alignas(4) uint32_t sampleBase;
+		alignas(4) uint32_t nLights;
 	};
 
-	struct alignas(16) BsdfSample
-	{
-		BsdfSample() = delete;
-
-		alignas(16) glm::vec3 f;
-		alignas(4)	float pdf;
-	};
-
-	struct alignas(16) LightSample
+	struct alignas(16) LightSampleRec
 	{
-		LightSample() = delete;
+		LightSampleRec() = delete;
 
-		alignas(16) glm::vec3 L;
-		alignas(4)	float pdf;
+		alignas(16) glm::vec3 bsdfEval;
+		alignas(4)	float bsdfPdf;
 		alignas(16) glm::vec3 emission;
-		alignas(4)  bool inShadow;
+		alignas(4)	float lightPdf;
+		alignas(16) glm::vec3 pad;
+		alignas(4)	float dist;
 	};
 
-	struct alignas(16) PathState
+	// Elements of a vec3 array take a vec4's stride in std430
+	struct alignas(16) Std430Vec3
 	{
-		PathState() = delete;
+		Std430Vec3() = delete;
 
-		alignas(16) glm::vec3 throughput;
-		alignas(16) glm::vec3 radiance;
-		alignas(4)	float mediumIOR;
-		alignas(16)	BsdfSample bsdfSample;
-		alignas(16) LightSample lightSample;
+		alignas(16) glm::vec3 v;
 	};
 
-	struct alignas(16) Hit
+	// Byte size of the PathStates block for this many paths, one std430 array per field in declaration order
+	size_t GetPathBufferSize(const uint32_t& nPaths);
+
+	// Compact hit record, the shade kernel rebuilds the shading data from it
+	struct Hit
 	{
 		Hit() = delete;
 
-		alignas(16) glm::vec3 point;
-		alignas(4)  float t;
-		alignas(16)	glm::vec3 lastPoint;
-		alignas(4)  bool emitter;
-		alignas(16) glm::vec3 N;
-		alignas(4)  uint32_t matid;
-		alignas(16) glm::vec3 V;
+		alignas(4) glm::vec2 barycentrics;
+		alignas(4) float t;
+		alignas(4) uint32_t primid;
+		alignas(4) uint32_t instid;
 	};
 
 	struct alignas(16) Ray 
@@ -100,6 +115,29 @@ namespace PT
 	};
 
 
+	// Counters of the statistics build, the kernels' MAX_DEPTH is defined as MAX_BOUNCES
+	struct RayStats
+	{
+		alignas(4) uint32_t extendRays = 0;
+		alignas(4) uint32_t shadowRays = 0;
+		alignas(4) uint32_t nodesVisited = 0;
+		alignas(4) uint32_t primitivesTested = 0;
+		alignas(4) uint32_t activePaths[MAX_BOUNCES + 1]{};
+	};
+
+	// Ray statistics summed over the batches read back since the last report
+	struct RayStatsReport
+	{
+		uint64_t extendRays = 0;
+		uint64_t shadowRays = 0;
+		uint64_t nodesVisited = 0;
+		uint64_t primitivesTested = 0;
+		uint64_t activePaths[MAX_BOUNCES + 1]{};
+		uint32_t batches = 0;
+		double gpuTime = 0.0;
+		double startTime = 0.0;
+	};
+
 	struct AccumulatorProfiler
 	{
 		bool reset		 = false;
@@ -130,12 +168,24 @@ namespace PT
 			explicit GLBuffer() = default;
 			~GLBuffer();
 
-			void InitBuffer(const uint32_t& type, const uint32_t& storageType);
+			// The name and owning subsystem label the buffer's storage in the GPU memory breakdown
+			void InitBuffer(const uint32_t& type, const uint32_t& storageType, const std::string& name = "unnamed", const std::string& subsystem = "Renderer");
 
 			void Bind();
 			void Unbind();
 
 			void InitData(const size_t& size, const uint32_t&& n, const uint32_t&& bufferIndex);
+			void InitData(const size_t& size, const uint32_t&& n);
+			// Immutable storage from glBufferStorage, mapped for the buffer's lifetime when the flags ask for a persistent mapping.
+			// Falls back to InitData when buffer storage is unavailable.
+			void InitStorage(const size_t& size, const uint32_t&& n, const uint32_t&& flags);
+			void ClearData();
+			// Fills [offset, offset + size) with a 32 bit value on the GPU timeline, unlike LoadData this never waits on dispatches in flight.
+			// The buffer must be bound, as for LoadData.
+			void ClearData(const uint32_t& value, const size_t& offset, const size_t& size);
+			void BindRange(const uint32_t& bufferIndex, const size_t& offset, const size_t& size);
+			// Bytes of the allocation actually filled, for buffers sized to a fixed capacity
+			void SetUsedBytes(const size_t& used);
 
 			template<typename T>
 			void LoadData(const T& data, const size_t&& offset, const uint32_t&& n)
@@ -155,9 +205,56 @@ namespace PT
 				glGetBufferSubData(m_type, offset, dataSize, data);
 			}
 
+			// Null unless the storage is persistently mapped
+			uint8_t* GetMappedData() const;
+
+			// GL 4.4 or ARB_buffer_storage
+			static bool HasBufferStorage();
+
 		private:
-			uint32_t m_id;
-			uint32_t m_type;
-			uint32_t m_storageType;
+			void TrackAllocation(const size_t& size, const std::string& usage);
+
+		private:
+			uint32_t m_id = 0;
+			uint32_t m_type = 0;
+			uint32_t m_storageType = 0;
+			std::string m_name;
+			std::string m_subsystem;
+			uint32_t m_allocation = GPU_NO_ALLOCATION;
+			uint8_t* m_mapped = nullptr;
+	};
+
+	// Fence guarded ring of upload memory for data that changes every frame or tile. Uploads are a memcpy into the
+	// persistently mapped buffer, and since every upload lands in a range the GPU is done with, none of them
+	// waits on the dispatches in flight like glBufferSubData into a busy buffer may.
+	class RingBuffer
+	{
+		public:
+			explicit RingBuffer() = default;
+			~RingBuffer();
+
+			void Init(const uint32_t& type, const size_t& segmentSize, const uint32_t& nSegments, const std::string& name, const std::string& subsystem);
+
+			// Copies the data into the ring and binds it to the buffer index
+			template<typename T>
+			void Upload(const T& data, const uint32_t&& bufferIndex)
+			{
+				size_t offset = Allocate(sizeof(data));
+				Write(&data, offset, sizeof(data));
+				m_buffer.BindRange(bufferIndex, offset, sizeof(data));
+			}
+
+		private:
+			size_t Allocate(const size_t& size);
+			void Write(const void* data, const size_t& offset, const size_t& size);
+
+		private:
+			GLBuffer m_buffer;
+			uint32_t m_type = 0;
+			std::vector<GLsync> m_fences;
+			size_t m_segmentSize = 0;
+			size_t m_alignment = 1;
+			size_t m_head = 0;
+			uint32_t m_segment = 0;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,201 @@
+#include <PT.h>
+#include "Capture.h"
+#include "ImageIO.h"
+#include "Profiler.h"
+
+namespace PT
+{
+	WorkerPool::WorkerPool() : m_running(0), m_stop(false) {}
+
+	WorkerPool::~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+
+		// Jobs still queued run before the threads exit
+		for (std::thread& thread : m_threads)
+			thread.join();
+	}
+
+	void WorkerPool::Init(const uint32_t& nThreads)
+	{
+		for (uint32_t i = 0; i < std::max<uint32_t>(1, nThreads); ++i)
+			m_threads.emplace_back(&WorkerPool::Run, this);
+	}
+
+	void WorkerPool::Submit(std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.push(std::move(job));
+		}
+		m_wake.notify_one();
+	}
+
+	void WorkerPool::Wait()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_idle.wait(lock, [this] { return m_jobs.empty() && m_running == 0; });
+	}
+
+	void WorkerPool::Run()
+	{
+		while (true)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+				if (m_jobs.empty())
+					return;
+
+				job = std::move(m_jobs.front());
+				m_jobs.pop();
+				++m_running;
+			}
+
+			job();
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				--m_running;
+			}
+			m_idle.notify_all();
+		}
+	}
+
+	FrameCapture::FrameCapture() : m_head(0), m_tail(0), m_encoding(0) {}
+
+	FrameCapture::~FrameCapture()
+	{
+		for (Slot& slot : m_slots)
+			if (slot.fence)
+				glDeleteSync(slot.fence);
+	}
+
+	void FrameCapture::Init(const CaptureSettings& settings)
+	{
+		m_settings = settings;
+		m_pool.Init(settings.encoderThreads);
+	}
+
+	bool FrameCapture::Request(const Image& accumulator, const std::string& name)
+	{
+		PROFILE_FUNCTION();
+		if (m_head - m_tail == s_ringSize)
+			return false;
+
+		// Readback buffers are only allocated once something is captured
+		Slot& slot = m_slots[m_head % s_ringSize];
+		const size_t size = size_t(accumulator.GetWidth()) * accumulator.GetHeight() * 4 * sizeof(float);
+		if (slot.size != size)
+		{
+			slot.buffer.InitBuffer(GL_PIXEL_PACK_BUFFER, GL_STREAM_READ, "frame capture readback", "Capture");
+			slot.buffer.InitData(size, 1);
+			slot.size = size;
+		}
+		slot.width = accumulator.GetWidth();
+		slot.height = accumulator.GetHeight();
+		slot.path = m_settings.outputPath + name + ImageIO::GetExtension(m_settings.format);
+
+		// The accumulator is written through image stores, they must land before the copy reads it
+		glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT);
+		slot.buffer.Bind();
+		accumulator.Bind();
+		glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, nullptr);
+		accumulator.Unbind();
+		slot.buffer.Unbind();
+
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		++m_head;
+		return true;
+	}
+
+	void FrameCapture::Collect()
+	{
+		PROFILE_FUNCTION();
+		while (m_tail != m_head)
+		{
+			Slot& slot = m_slots[m_tail % s_ringSize];
+			GLenum status = glClientWaitSync(slot.fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				break;
+
+			glDeleteSync(slot.fence);
+			slot.fence = nullptr;
+
+			// The copy has landed, reading it back no longer waits on the GPU
+			std::vector<float> rgba(slot.size / sizeof(float));
+			slot.buffer.Bind();
+			slot.buffer.GetData(0, size_t(slot.size), rgba.data());
+			slot.buffer.Unbind();
+			++m_tail;
+
+			++m_encoding;
+			m_pool.Submit([this, path = slot.path, width = slot.width, height = slot.height, rgba = std::move(rgba)]
+			{
+				Encode(path, width, height, rgba);
+				--m_encoding;
+			});
+		}
+
+		std::vector<std::pair<std::string, double>> results;
+		{
+			std::lock_guard<std::mutex> lock(m_resultMutex);
+			results.swap(m_results);
+		}
+
+		for (const auto& result : results)
+		{
+			if (result.second < 0.0)
+				LOG_WARNING("Failed to save the render to: ", result.first, "\n");
+			else
+				LOG_INFO("Saved the render to ", result.first, " in ", result.second, " ms\n");
+		}
+	}
+
+	void FrameCapture::Flush()
+	{
+		PROFILE_FUNCTION();
+		for (uint32_t i = m_tail; i != m_head; ++i)
+			glClientWaitSync(m_slots[i % s_ringSize].fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+
+		Collect();
+		m_pool.Wait();
+		Collect();
+	}
+
+	bool FrameCapture::IsBusy() const
+	{
+		return m_head != m_tail || m_encoding > 0;
+	}
+
+	void FrameCapture::Encode(const std::string& path, const uint32_t& width, const uint32_t& height, const std::vector<float>& rgba)
+	{
+		PROFILE_FUNCTION();
+		Timer timer;
+		timer.Start();
+
+		// Resolve the running sums by their sample count, kept in alpha, and flip the rows to top to bottom
+		std::vector<float> rgb(size_t(width) * height * 3);
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				const float* texel = &rgba[(size_t(height - 1 - y) * width + x) * 4];
+				const float weight = texel[3] > 0.0f ? 1.0f / texel[3] : 0.0f;
+				for (uint32_t c = 0; c < 3; ++c)
+					rgb[(size_t(y) * width + x) * 3 + c] = texel[c] * weight;
+			}
+		}
+
+		const bool saved = ImageIO::WriteImage(path, m_settings.format, width, height, rgb);
+		timer.Stop();
+
+		std::lock_guard<std::mutex> lock(m_resultMutex);
+		m_results.emplace_back(path, saved ? timer.GetLast() : -1.0);
+	}
+}
\ No newline at end of file
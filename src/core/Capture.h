@@ -0,0 +1,82 @@
+#pragma once
+#include "Logger.h"
+#include "Settings.h"
+#include "Buffer.h"
+#include "Texture.h"
+
+namespace PT
+{
+	// Fixed set of threads running submitted jobs. Jobs start in submission order, but with more than one thread
+	// they run concurrently and may finish in any order.
+	class WorkerPool final
+	{
+		public:
+			explicit WorkerPool();
+			~WorkerPool();
+
+			void Init(const uint32_t& nThreads);
+			void Submit(std::function<void()> job);
+			// Blocks until every submitted job has run
+			void Wait();
+
+		private:
+			void Run();
+
+			std::vector<std::thread> m_threads;
+			std::queue<std::function<void()>> m_jobs;
+			std::mutex m_mutex;
+			std::condition_variable m_wake;
+			std::condition_variable m_idle;
+			uint32_t m_running;
+			bool m_stop;
+	};
+
+	// Saves the accumulated image without stalling the render loop. The accumulator is copied into a ring of
+	// pixel pack buffers on the GPU timeline, a fence tells when a copy has landed, and resolving and encoding
+	// the frame run on the worker pool. Results are logged from Collect, on the render thread.
+	class FrameCapture final
+	{
+		public:
+			explicit FrameCapture();
+			~FrameCapture();
+
+			void Init(const CaptureSettings& settings);
+
+			// Queues a copy of the accumulator saved as outputPath + name, false when every slot is still in flight
+			bool Request(const Image& accumulator, const std::string& name);
+			// Hands the copies that have landed to the encoders, called once per frame
+			void Collect();
+			// Waits for every copy and encode in flight
+			void Flush();
+
+			// Copies or encodes still in flight
+			bool IsBusy() const;
+
+		private:
+			struct Slot
+			{
+				GLBuffer buffer;
+				GLsync fence = nullptr;
+				size_t size = 0;
+				uint32_t width = 0;
+				uint32_t height = 0;
+				std::string path;
+			};
+
+			void Encode(const std::string& path, const uint32_t& width, const uint32_t& height, const std::vector<float>& rgba);
+
+			static constexpr uint32_t s_ringSize = 3;
+			Slot m_slots[s_ringSize];
+			uint32_t m_head;
+			uint32_t m_tail;
+
+			CaptureSettings m_settings;
+			std::atomic<uint32_t> m_encoding;
+			// Path and encoding time of the files written since the last Collect, negative for failed ones
+			std::mutex m_resultMutex;
+			std::vector<std::pair<std::string, double>> m_results;
+
+			// Last so its threads are joined before the state the jobs touch is destroyed
+			WorkerPool m_pool;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,174 @@
+#include <PT.h>
+#include "CommandLine.h"
+
+namespace PT
+{
+	namespace
+	{
+		const char* USAGE =
+			"Usage: PathTracer [options]\n"
+			"  --scene <path>        Scene to render, only the built-in resources/scenes/default.scene for now\n"
+			"  --width <pixels>      Render width\n"
+			"  --height <pixels>     Render height\n"
+			"  --headless            Render offscreen until a limit is reached, save the image and exit\n"
+			"  --spp <samples>       Samples per pixel to render headless, 0 for no limit\n"
+			"  --time <seconds>      Time limit of a headless render, 0 for no limit\n"
+			"  --output <file>       Image of a headless render, .exr, .pfm or .png\n"
+			"  --float               Write EXR images with float instead of half channels\n"
+			"  --stats <file>        Render statistics of a headless render in JSON\n"
+			"  --context <api>       GL context of a headless render: native, egl or osmesa\n"
+			"  --profile-stages      Time every GPU stage, the statistics are written to the profiler output on exit\n"
+			"  --shadow-benchmark    Time the shadow ray traversal against the reference one, logged on exit\n"
+			"  --help                Show this message\n";
+
+		bool ParseNumber(const std::string& option, const std::string& value, double& number)
+		{
+			try
+			{
+				size_t end = 0;
+				number = std::stod(value, &end);
+				if (end == value.size() && number >= 0.0)
+					return true;
+			}
+			catch (const std::exception&) {}
+
+			LOG_CRITICAL("Invalid value for ", option, ": ", value, "\n");
+			return false;
+		}
+
+		bool ParseOutput(const std::string& value, Settings& settings)
+		{
+			std::filesystem::path path(value);
+			std::string extension = path.extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(), [](const char& c) { return char(std::tolower(c)); });
+
+			if (extension == ".exr")
+				settings.captureSettings.format = ImageFormat::EXRHalf;
+			else if (extension == ".pfm")
+				settings.captureSettings.format = ImageFormat::PFM;
+			else if (extension == ".png")
+				settings.captureSettings.format = ImageFormat::PNG;
+			else
+			{
+				LOG_CRITICAL("Unsupported image format: ", value, ", use .exr, .pfm or .png\n");
+				return false;
+			}
+
+			// The capture appends the extension of its format
+			settings.captureSettings.outputPath = path.has_parent_path() ? path.parent_path().string() + "/" : "";
+			settings.headlessSettings.outputName = path.stem().string();
+			return true;
+		}
+	}
+
+	bool ParseCommandLine(const int& argc, char** argv, Settings& settings)
+	{
+		bool floatChannels = false;
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string option = argv[i];
+			if (option == "--help")
+			{
+				LOG(USAGE);
+				return false;
+			}
+			if (option == "--headless")
+			{
+				settings.headlessSettings.enabled = true;
+				continue;
+			}
+			if (option == "--float")
+			{
+				floatChannels = true;
+				continue;
+			}
+			if (option == "--profile-stages")
+			{
+				settings.profilerSettings.gpuStages = true;
+				continue;
+			}
+			if (option == "--shadow-benchmark")
+			{
+				settings.profilerSettings.shadowBenchmark = true;
+				continue;
+			}
+
+			// Every other option takes a value
+			if (i + 1 >= argc)
+			{
+				LOG_CRITICAL("Missing value for ", option, "\n", USAGE);
+				return false;
+			}
+			const std::string value = argv[++i];
+			double number = 0.0;
+
+			if (option == "--scene")
+			{
+				// Scenes aren't loaded from files yet, rendering the built-in one under another name would mislabel the output
+				if (value != BUILT_IN_SCENE)
+				{
+					LOG_CRITICAL("Scene files can't be loaded yet, only the built-in scene ", BUILT_IN_SCENE, " is available: ", value, "\n");
+					return false;
+				}
+				settings.renderSettings.scenePath = value;
+			}
+			else if (option == "--width" || option == "--height")
+			{
+				if (!ParseNumber(option, value, number) || number < 1.0)
+					return false;
+				// The window and the render target share the resolution
+				(option == "--width" ? settings.videoSettings.width : settings.videoSettings.height) = uint32_t(number);
+				(option == "--width" ? settings.renderSettings.width : settings.renderSettings.height) = uint32_t(number);
+			}
+			else if (option == "--spp")
+			{
+				if (!ParseNumber(option, value, number))
+					return false;
+				settings.headlessSettings.samplesPerPixel = uint32_t(number);
+			}
+			else if (option == "--time")
+			{
+				if (!ParseNumber(option, value, number))
+					return false;
+				settings.headlessSettings.timeLimit = number;
+			}
+			else if (option == "--output")
+			{
+				if (!ParseOutput(value, settings))
+					return false;
+			}
+			else if (option == "--stats")
+				settings.headlessSettings.statsPath = value;
+			else if (option == "--context")
+			{
+				if (value == "native")
+					settings.headlessSettings.contextAPI = ContextAPI::Native;
+				else if (value == "egl")
+					settings.headlessSettings.contextAPI = ContextAPI::EGL;
+				else if (value == "osmesa")
+					settings.headlessSettings.contextAPI = ContextAPI::OSMesa;
+				else
+				{
+					LOG_CRITICAL("Unknown context API: ", value, ", use native, egl or osmesa\n");
+					return false;
+				}
+			}
+			else
+			{
+				LOG_CRITICAL("Unknown option: ", option, "\n", USAGE);
+				return false;
+			}
+		}
+
+		if (floatChannels && settings.captureSettings.format == ImageFormat::EXRHalf)
+			settings.captureSettings.format = ImageFormat::EXRFloat;
+
+		if (settings.headlessSettings.enabled && settings.headlessSettings.samplesPerPixel == 0 && settings.headlessSettings.timeLimit <= 0.0)
+		{
+			LOG_CRITICAL("A headless render needs a sample or time limit\n");
+			return false;
+		}
+
+		return true;
+	}
+}
\ No newline at end of file
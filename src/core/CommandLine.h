@@ -0,0 +1,11 @@
+#pragma once
+#include "Logger.h"
+#include "Settings.h"
+
+namespace PT
+{
+	// Overrides the settings from the command line, e.g.
+	//	PathTracer --headless --scene resources/scenes/default.scene --width 1920 --height 1080 --spp 1024 --output renders/default.exr
+	// Returns false when the program should exit instead, after --help or on an invalid argument.
+	bool ParseCommandLine(const int& argc, char** argv, Settings& settings);
+}
\ No newline at end of file
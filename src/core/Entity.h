@@ -100,4 +100,23 @@ namespace PT
 		glm::vec3 worldPos;
 		float area;
 	};
+
+	// Triangle of an emissive mesh in world space, it emits from both faces
+	struct alignas(16) TriangleLight
+	{
+		TriangleLight(const glm::vec3& t_p0, const glm::vec3& t_p1, const glm::vec3& t_p2, const glm::vec3& t_emission) :
+			p0(t_p0), p1(t_p1), _pad0(0.0f), p2(t_p2), _pad1(0.0f), emission(t_emission), _pad2(0.0f)
+		{
+			area = 0.5f * glm::length(glm::cross(p1 - p0, p2 - p0));
+		}
+
+		glm::vec3 p0;
+		float area;
+		glm::vec3 p1;
+		float _pad0;
+		glm::vec3 p2;
+		float _pad1;
+		glm::vec3 emission;
+		float _pad2;
+	};
 }
\ No newline at end of file
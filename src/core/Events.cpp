@@ -1,5 +1,6 @@
 #include <PT.h>
 #include "Events.h"
+#include "Profiler.h"
 
 namespace PT
 {
@@ -43,6 +44,31 @@ namespace PT
 		type = EventType::MouseButtonState;
 	}
 
+	SwitchRenderModeEvent::SwitchRenderModeEvent()
+	{
+		type = EventType::SwitchRenderMode;
+	}
+
+	ToggleProfilerOverlayEvent::ToggleProfilerOverlayEvent()
+	{
+		type = EventType::ToggleProfilerOverlay;
+	}
+
+	CaptureTraceEvent::CaptureTraceEvent()
+	{
+		type = EventType::CaptureTrace;
+	}
+
+	LogMemoryUsageEvent::LogMemoryUsageEvent()
+	{
+		type = EventType::LogMemoryUsage;
+	}
+
+	SaveImageEvent::SaveImageEvent()
+	{
+		type = EventType::SaveImage;
+	}
+
 	void SetEventCallback(EventType etype, Handler handler)
 	{
 		handlers[etype].push_back(handler);
@@ -50,6 +76,7 @@ namespace PT
 
 	void DispatchEvent(Event& e)
 	{
+		PROFILE_FUNCTION();
 		if (!handlers[e.type].empty())
 			for(auto i = 0; i < handlers[e.type].size(); ++i)
 				std::invoke(handlers[e.type][i], &e);
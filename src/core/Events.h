@@ -2,7 +2,7 @@
 
 namespace PT 
 {
-	enum class EventType { None, ResetAccumulator, CloseApp, CameraZoom, CameraDolly, CameraPan, CameraOrbit, MouseButtonState };
+	enum class EventType { None, ResetAccumulator, CloseApp, CameraZoom, CameraDolly, CameraPan, CameraOrbit, MouseButtonState, SwitchRenderMode, ToggleProfilerOverlay, CaptureTrace, LogMemoryUsage, SaveImage };
 
 	struct Event 
 	{
@@ -55,6 +55,31 @@ namespace PT
 		bool state;
 	};
 
+	struct SwitchRenderModeEvent : public Event
+	{
+		explicit SwitchRenderModeEvent();
+	};
+
+	struct ToggleProfilerOverlayEvent : public Event
+	{
+		explicit ToggleProfilerOverlayEvent();
+	};
+
+	struct CaptureTraceEvent : public Event
+	{
+		explicit CaptureTraceEvent();
+	};
+
+	struct LogMemoryUsageEvent : public Event
+	{
+		explicit LogMemoryUsageEvent();
+	};
+
+	struct SaveImageEvent : public Event
+	{
+		explicit SaveImageEvent();
+	};
+
 	using Handler = std::function<void(Event* e)>;
 	using EventHandler = std::map<EventType, std::vector<Handler>>;
 
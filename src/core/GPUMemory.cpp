@@ -0,0 +1,140 @@
+#include <PT.h>
+#include "GPUMemory.h"
+
+namespace PT::GPUMemory
+{
+	namespace
+	{
+		// Freed entries stay in place so ids never change, their slots are reused by later allocations
+		struct Registry
+		{
+			std::vector<GPUAllocation> allocations;
+			std::vector<uint32_t> freeIds;
+		};
+
+		// Never destroyed, buffers and textures held in globals release their entries during static destruction
+		Registry& GetRegistry()
+		{
+			static Registry* registry = new Registry();
+			return *registry;
+		}
+
+		// Unused capacity past this fraction of an allocation is flagged in the breakdown
+		constexpr double WASTE_WARNING = 0.5;
+
+		double ToMB(const size_t& bytes)
+		{
+			return double(bytes) / (1024.0 * 1024.0);
+		}
+	}
+
+	uint32_t Allocate(const std::string& name, const std::string& subsystem, const std::string& usage, const size_t& size)
+	{
+		std::vector<GPUAllocation>& allocations = GetRegistry().allocations;
+		std::vector<uint32_t>& freeIds = GetRegistry().freeIds;
+		GPUAllocation allocation{ name, subsystem, usage, size, 0, true };
+		if (!freeIds.empty())
+		{
+			uint32_t id = freeIds.back();
+			freeIds.pop_back();
+			allocations[id] = allocation;
+			return id;
+		}
+
+		allocations.push_back(allocation);
+		return uint32_t(allocations.size() - 1);
+	}
+
+	void Resize(const uint32_t& id, const size_t& size)
+	{
+		std::vector<GPUAllocation>& allocations = GetRegistry().allocations;
+		if (id >= allocations.size() || !allocations[id].live)
+			return;
+
+		allocations[id].size = size;
+		allocations[id].used = 0;
+	}
+
+	void SetUsed(const uint32_t& id, const size_t& used)
+	{
+		std::vector<GPUAllocation>& allocations = GetRegistry().allocations;
+		if (id >= allocations.size() || !allocations[id].live)
+			return;
+
+		allocations[id].used = std::min(used, allocations[id].size);
+	}
+
+	void Free(const uint32_t& id)
+	{
+		std::vector<GPUAllocation>& allocations = GetRegistry().allocations;
+		std::vector<uint32_t>& freeIds = GetRegistry().freeIds;
+		if (id >= allocations.size() || !allocations[id].live)
+			return;
+
+		allocations[id].live = false;
+		freeIds.push_back(id);
+	}
+
+	size_t GetTotal()
+	{
+		std::vector<GPUAllocation>& allocations = GetRegistry().allocations;
+		size_t total = 0;
+		for (const GPUAllocation& allocation : allocations)
+			if (allocation.live)
+				total += allocation.size;
+		return total;
+	}
+
+	std::vector<GPUAllocation> GetAllocations()
+	{
+		std::vector<GPUAllocation>& allocations = GetRegistry().allocations;
+		std::vector<GPUAllocation> live;
+		for (const GPUAllocation& allocation : allocations)
+			if (allocation.live)
+				live.push_back(allocation);
+		return live;
+	}
+
+	void LogBreakdown()
+	{
+		std::vector<GPUAllocation> live = GetAllocations();
+		std::stable_sort(live.begin(), live.end(), [](const GPUAllocation& a, const GPUAllocation& b)
+		{
+			return a.subsystem != b.subsystem ? a.subsystem < b.subsystem : a.size > b.size;
+		});
+
+		std::ostringstream report;
+		report.precision(2);
+		report << std::fixed << "GPU memory: " << ToMB(GetTotal()) << " MB in " << live.size() << " allocations\n";
+
+		std::string subsystem;
+		size_t wasted = 0;
+		for (const GPUAllocation& allocation : live)
+		{
+			if (allocation.subsystem != subsystem)
+			{
+				subsystem = allocation.subsystem;
+				size_t subtotal = 0;
+				for (const GPUAllocation& other : live)
+					if (other.subsystem == subsystem)
+						subtotal += other.size;
+				report << "  " << subsystem << ": " << ToMB(subtotal) << " MB\n";
+			}
+
+			report << "    " << allocation.name << " (" << allocation.usage << "): " << ToMB(allocation.size) << " MB";
+			if (allocation.used > 0)
+			{
+				size_t unused = allocation.size - allocation.used;
+				double fraction = double(unused) / double(allocation.size);
+				report << ", " << ToMB(allocation.used) << " MB used";
+				if (fraction > WASTE_WARNING)
+					report << " <- " << 100.0 * fraction << "% unused";
+				wasted += unused;
+			}
+			report << "\n";
+		}
+		report << "  Unused capacity of the allocations that report it: " << ToMB(wasted) << " MB\n";
+
+		LOG_INFO(report.str());
+	}
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+#include "Logger.h"
+
+#define GPU_NO_ALLOCATION 0xFFFFFFFFu
+
+namespace PT
+{
+	// One block of GPU memory as requested from the driver. Owners that know how much of it they fill
+	// report the used bytes, which is how over-sized slabs show up in the breakdown.
+	struct GPUAllocation
+	{
+		std::string name;
+		std::string subsystem;
+		std::string usage;
+		size_t size = 0;
+		size_t used = 0;	// Zero while the owner has not reported it
+		bool live = false;
+	};
+
+	// Registry of every buffer and texture allocation, it does no GL calls itself
+	namespace GPUMemory
+	{
+		uint32_t Allocate(const std::string& name, const std::string& subsystem, const std::string& usage, const size_t& size);
+		void Resize(const uint32_t& id, const size_t& size);
+		void SetUsed(const uint32_t& id, const size_t& used);
+		void Free(const uint32_t& id);
+
+		size_t GetTotal();
+		std::vector<GPUAllocation> GetAllocations();
+
+		// Allocations grouped by subsystem, largest first, with the unused capacity of those that report it
+		void LogBreakdown();
+	}
+}
\ No newline at end of file
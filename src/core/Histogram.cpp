@@ -0,0 +1,91 @@
+#include <PT.h>
+#include "Histogram.h"
+
+namespace PT
+{
+	Histogram::Histogram(const double& lowest, const double& highest) : m_lowest(lowest), m_count(0), m_min(0.0), m_max(0.0), m_sum(0.0)
+	{
+		uint32_t magnitudes = uint32_t(std::ceil(std::log2(highest / lowest))) + 1;
+		m_counts.assign(magnitudes * s_subBuckets, 0);
+	}
+
+	void Histogram::Record(const double& value)
+	{
+		m_min = m_count ? std::min(m_min, value) : value;
+		m_max = m_count ? std::max(m_max, value) : value;
+		m_sum += value;
+		++m_count;
+		++m_counts[BucketIndex(value)];
+	}
+
+	void Histogram::Reset()
+	{
+		std::fill(m_counts.begin(), m_counts.end(), 0);
+		m_count = 0;
+		m_min = m_max = m_sum = 0.0;
+	}
+
+	double Histogram::GetPercentile(const double& p) const
+	{
+		if (m_count == 0)
+			return 0.0;
+
+		// Rank of the sample, one based
+		uint64_t rank = std::max<uint64_t>(1, uint64_t(std::ceil(std::clamp(p, 0.0, 100.0) * 0.01 * double(m_count))));
+		uint64_t seen = 0;
+		for (uint32_t i = 0; i < m_counts.size(); ++i)
+		{
+			seen += m_counts[i];
+			if (seen >= rank)
+				return std::clamp(BucketValue(i), m_min, m_max);
+		}
+		return m_max;
+	}
+
+	double Histogram::GetMin() const
+	{
+		return m_min;
+	}
+
+	double Histogram::GetMax() const
+	{
+		return m_max;
+	}
+
+	double Histogram::GetMean() const
+	{
+		return m_count ? m_sum / double(m_count) : 0.0;
+	}
+
+	uint64_t Histogram::GetCount() const
+	{
+		return m_count;
+	}
+
+	uint32_t Histogram::BucketIndex(const double& value) const
+	{
+		double ratio = value / m_lowest;
+		if (!(ratio >= 1.0))
+			return 0;
+
+		// ratio = mantissa * 2^exponent with the mantissa in [0.5, 1)
+		int exponent;
+		double mantissa = std::frexp(ratio, &exponent);
+		uint32_t magnitude = uint32_t(exponent - 1);
+		uint32_t sub = std::min(s_subBuckets - 1, uint32_t((mantissa * 2.0 - 1.0) * s_subBuckets));
+
+		return std::min(uint32_t(m_counts.size()) - 1, magnitude * s_subBuckets + sub);
+	}
+
+	uint32_t Histogram::GetBucketCount() const
+	{
+		return uint32_t(m_counts.size());
+	}
+
+	double Histogram::BucketValue(const uint32_t& index) const
+	{
+		uint32_t magnitude = index / s_subBuckets;
+		uint32_t sub = index % s_subBuckets;
+		return m_lowest * std::ldexp(1.0 + (double(sub) + 0.5) / s_subBuckets, int(magnitude));
+	}
+}
\ No newline at end of file
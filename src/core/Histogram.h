@@ -0,0 +1,39 @@
+#pragma once
+#include "Logger.h"
+
+namespace PT
+{
+	// Streaming histogram in bounded memory, HDR histogram style: every power of two above the lowest
+	// trackable value is split into s_subBuckets linear buckets, so percentiles carry at most 1/s_subBuckets
+	// relative error whatever the number of samples. Values outside [lowest, highest] land in the end buckets,
+	// the exact minimum, maximum and mean are tracked on the side.
+	class Histogram final
+	{
+		public:
+			explicit Histogram(const double& lowest = 1e-3, const double& highest = 1e6);
+
+			void Record(const double& value);
+			void Reset();
+
+			// p in [0, 100], returns the middle of the bucket holding the p-th percentile clamped to the recorded range
+			double GetPercentile(const double& p) const;
+			double GetMin() const;
+			double GetMax() const;
+			double GetMean() const;
+			uint64_t GetCount() const;
+
+			// Bucket a value is counted in and the value reported for a bucket
+			uint32_t BucketIndex(const double& value) const;
+			double BucketValue(const uint32_t& index) const;
+			uint32_t GetBucketCount() const;
+
+		private:
+			static constexpr uint32_t s_subBuckets = 32;
+			double m_lowest;
+			std::vector<uint64_t> m_counts;
+			uint64_t m_count;
+			double m_min;
+			double m_max;
+			double m_sum;
+	};
+}
\ No newline at end of file
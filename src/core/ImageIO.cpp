@@ -0,0 +1,240 @@
+#include <PT.h>
+#include "ImageIO.h"
+#include "Profiler.h"
+
+namespace PT::ImageIO
+{
+	namespace
+	{
+		template<typename T>
+		void Put(std::string& out, const T& value)
+		{
+			out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+		}
+
+		void PutBigEndian(std::string& out, const uint32_t& value)
+		{
+			out.push_back(char(value >> 24));
+			out.push_back(char(value >> 16));
+			out.push_back(char(value >> 8));
+			out.push_back(char(value));
+		}
+
+		void PutAttribute(std::string& out, const std::string& name, const std::string& type, const std::string& value)
+		{
+			out.append(name).push_back('\0');
+			out.append(type).push_back('\0');
+			Put(out, int32_t(value.size()));
+			out.append(value);
+		}
+
+		uint32_t Crc32(const std::string& data, const size_t& begin)
+		{
+			static const std::array<uint32_t, 256> table = []
+			{
+				std::array<uint32_t, 256> crcs{};
+				for (uint32_t i = 0; i < 256; ++i)
+				{
+					uint32_t c = i;
+					for (uint32_t k = 0; k < 8; ++k)
+						c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+					crcs[i] = c;
+				}
+				return crcs;
+			}();
+
+			uint32_t crc = 0xFFFFFFFFu;
+			for (size_t i = begin; i < data.size(); ++i)
+				crc = table[(crc ^ uint8_t(data[i])) & 0xFF] ^ (crc >> 8);
+			return crc ^ 0xFFFFFFFFu;
+		}
+
+		uint32_t Adler32(const std::string& data)
+		{
+			uint32_t a = 1, b = 0;
+			for (const char& byte : data)
+			{
+				a = (a + uint8_t(byte)) % 65521;
+				b = (b + a) % 65521;
+			}
+			return (b << 16) | a;
+		}
+
+		void PutChunk(std::string& out, const char* type, const std::string& data)
+		{
+			PutBigEndian(out, uint32_t(data.size()));
+			const size_t begin = out.size();
+			out.append(type, 4).append(data);
+			PutBigEndian(out, Crc32(out, begin));
+		}
+
+		// Same operator as the output shader
+		uint8_t ToneMap(const float& value)
+		{
+			float mapped = std::sqrt(std::max(value, 0.0f) / (std::max(value, 0.0f) + 1.0f));
+			return uint8_t(std::min(mapped * 255.0f + 0.5f, 255.0f));
+		}
+
+		bool WriteFile(const std::string& path, const std::string& data)
+		{
+			std::error_code error;
+			std::filesystem::path target(path);
+			if (target.has_parent_path())
+				std::filesystem::create_directories(target.parent_path(), error);
+
+			const std::string partial = path + ".part";
+			{
+				std::ofstream file(partial, std::ios::binary | std::ios::trunc);
+				if (!file.is_open())
+					return false;
+				file.write(data.data(), std::streamsize(data.size()));
+				if (!file)
+					return false;
+			}
+
+			std::filesystem::rename(partial, target, error);
+			return !error;
+		}
+	}
+
+	bool WriteImage(const std::string& path, const ImageFormat& format, const uint32_t& width, const uint32_t& height, const std::vector<float>& rgb)
+	{
+		switch (format)
+		{
+			case ImageFormat::EXRHalf:  return WriteEXR(path, width, height, rgb, true);
+			case ImageFormat::EXRFloat: return WriteEXR(path, width, height, rgb, false);
+			case ImageFormat::PFM:		return WritePFM(path, width, height, rgb);
+			case ImageFormat::PNG:		return WritePNG(path, width, height, rgb);
+			default:					return false;
+		}
+	}
+
+	bool WriteEXR(const std::string& path, const uint32_t& width, const uint32_t& height, const std::vector<float>& rgb, const bool& half)
+	{
+		PROFILE_FUNCTION();
+		std::string out;
+		Put(out, uint32_t(20000630));	// Magic number
+		Put(out, uint32_t(2));			// Version 2, single part scan line file
+
+		// Channels are listed and stored in alphabetical order
+		std::string channels;
+		for (const char* name : { "B", "G", "R" })
+		{
+			channels.append(name).push_back('\0');
+			Put(channels, int32_t(half ? 1 : 2));	// HALF or FLOAT
+			Put(channels, uint32_t(0));				// pLinear and reserved bytes
+			Put(channels, int32_t(1));				// x and y sampling
+			Put(channels, int32_t(1));
+		}
+		channels.push_back('\0');
+
+		std::string window;
+		Put(window, int32_t(0));
+		Put(window, int32_t(0));
+		Put(window, int32_t(width) - 1);
+		Put(window, int32_t(height) - 1);
+
+		std::string one, center;
+		Put(one, 1.0f);
+		Put(center, 0.0f);
+		Put(center, 0.0f);
+
+		PutAttribute(out, "channels", "chlist", channels);
+		PutAttribute(out, "compression", "compression", std::string(1, '\0'));
+		PutAttribute(out, "dataWindow", "box2i", window);
+		PutAttribute(out, "displayWindow", "box2i", window);
+		PutAttribute(out, "lineOrder", "lineOrder", std::string(1, '\0'));
+		PutAttribute(out, "pixelAspectRatio", "float", one);
+		PutAttribute(out, "screenWindowCenter", "v2f", center);
+		PutAttribute(out, "screenWindowWidth", "float", one);
+		out.push_back('\0');
+
+		// Uncompressed files hold one scan line per chunk, each chunk is preceded by its y and byte count
+		const size_t lineBytes = size_t(width) * 3 * (half ? sizeof(uint16_t) : sizeof(float));
+		const uint64_t firstChunk = out.size() + sizeof(uint64_t) * height;
+		for (uint32_t y = 0; y < height; ++y)
+			Put(out, uint64_t(firstChunk + y * (2 * sizeof(int32_t) + lineBytes)));
+
+		out.reserve(out.size() + height * (2 * sizeof(int32_t) + lineBytes));
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			Put(out, int32_t(y));
+			Put(out, int32_t(lineBytes));
+			for (uint32_t c = 3; c-- > 0;)
+			{
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					const float value = rgb[(size_t(y) * width + x) * 3 + c];
+					if (half)
+						Put(out, uint16_t(glm::packHalf2x16(glm::vec2(value, 0.0f)) & 0xFFFF));
+					else
+						Put(out, value);
+				}
+			}
+		}
+
+		return WriteFile(path, out);
+	}
+
+	bool WritePFM(const std::string& path, const uint32_t& width, const uint32_t& height, const std::vector<float>& rgb)
+	{
+		PROFILE_FUNCTION();
+		// A negative scale marks little endian data, rows go from bottom to top
+		std::string out = "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n-1.0\n";
+		out.reserve(out.size() + rgb.size() * sizeof(float));
+		for (uint32_t y = height; y-- > 0;)
+			out.append(reinterpret_cast<const char*>(&rgb[size_t(y) * width * 3]), size_t(width) * 3 * sizeof(float));
+
+		return WriteFile(path, out);
+	}
+
+	bool WritePNG(const std::string& path, const uint32_t& width, const uint32_t& height, const std::vector<float>& rgb)
+	{
+		PROFILE_FUNCTION();
+		// Every row starts with its filter type, none
+		std::string raw;
+		raw.reserve(size_t(height) * (size_t(width) * 3 + 1));
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			raw.push_back('\0');
+			for (size_t i = size_t(y) * width * 3; i < size_t(y + 1) * width * 3; ++i)
+				raw.push_back(char(ToneMap(rgb[i])));
+		}
+
+		// zlib stream of stored deflate blocks, at most 65535 bytes each
+		std::string zlib = { char(0x78), char(0x01) };
+		for (size_t offset = 0; offset < raw.size() || offset == 0; offset += 65535)
+		{
+			const uint16_t length = uint16_t(std::min<size_t>(65535, raw.size() - offset));
+			zlib.push_back(offset + length >= raw.size() ? char(1) : char(0));
+			Put(zlib, length);
+			Put(zlib, uint16_t(~length));
+			zlib.append(raw, offset, length);
+		}
+		PutBigEndian(zlib, Adler32(raw));
+
+		std::string header;
+		PutBigEndian(header, width);
+		PutBigEndian(header, height);
+		header.append({ char(8), char(2), char(0), char(0), char(0) });	// 8 bit RGB, deflate, no filter, no interlace
+
+		std::string out = "\x89PNG\r\n\x1A\n";
+		PutChunk(out, "IHDR", header);
+		PutChunk(out, "IDAT", zlib);
+		PutChunk(out, "IEND", std::string());
+
+		return WriteFile(path, out);
+	}
+
+	std::string GetExtension(const ImageFormat& format)
+	{
+		switch (format)
+		{
+			case ImageFormat::EXRHalf:
+			case ImageFormat::EXRFloat: return ".exr";
+			case ImageFormat::PFM:		return ".pfm";
+			case ImageFormat::PNG:		return ".png";
+			default:					return "";
+		}
+	}
+}
\ No newline at end of file
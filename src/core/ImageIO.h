@@ -0,0 +1,18 @@
+#pragma once
+#include "Logger.h"
+#include "Settings.h"
+
+namespace PT::ImageIO
+{
+	// Encoders for renders written to disk. Pixels are linear RGB, three floats per pixel, rows from top to bottom.
+	// Files are written next to their path and renamed over it once complete, so an autosave never leaves a torn image.
+	bool WriteImage(const std::string& path, const ImageFormat& format, const uint32_t& width, const uint32_t& height, const std::vector<float>& rgb);
+
+	// Single part scan line OpenEXR, uncompressed, with half or float channels
+	bool WriteEXR(const std::string& path, const uint32_t& width, const uint32_t& height, const std::vector<float>& rgb, const bool& half);
+	bool WritePFM(const std::string& path, const uint32_t& width, const uint32_t& height, const std::vector<float>& rgb);
+	// 8 bit PNG tone mapped like the window output, the deflate stream is made of stored blocks
+	bool WritePNG(const std::string& path, const uint32_t& width, const uint32_t& height, const std::vector<float>& rgb);
+
+	std::string GetExtension(const ImageFormat& format);
+}
\ No newline at end of file
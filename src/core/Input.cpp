@@ -1,5 +1,6 @@
 #include <PT.h>
 #include "Input.h"
+#include "Profiler.h"
 
 namespace PT::Input
 {
@@ -12,6 +13,16 @@ namespace PT::Input
 
 		void ResetAccumulator() { NewEvent<ResetAccumulatorEvent>(glfwGetTime()); }
 
+		void SwitchRenderMode() { NewEvent<SwitchRenderModeEvent>(); }
+
+		void ToggleProfilerOverlay() { NewEvent<ToggleProfilerOverlayEvent>(); }
+
+		void CaptureTrace() { NewEvent<CaptureTraceEvent>(); }
+
+		void LogMemoryUsage() { NewEvent<LogMemoryUsageEvent>(); }
+
+		void SaveImage() { NewEvent<SaveImageEvent>(); }
+
 		void CameraZoomIn()  { ResetAccumulator(); NewEvent<CameraZoomEvent>(-5.0f); }
 		void CameraZoomOut() { ResetAccumulator(); NewEvent<CameraZoomEvent>( 5.0f); }
 		void CameraDolly(double& yoffset, float& delta_t) { ResetAccumulator(); NewEvent<CameraDollyEvent>(yoffset, delta_t); }
@@ -64,6 +75,11 @@ namespace PT::Input
 			keys[GLFW_KEY_ESCAPE].SetOnKeyPress(Exit);
 			keys[GLFW_KEY_R].SetOnKeyPress(CameraZoomIn);
 			keys[GLFW_KEY_F].SetOnKeyPress(CameraZoomOut);
+			keys[GLFW_KEY_M].SetOnKeyPress(SwitchRenderMode);
+			keys[GLFW_KEY_P].SetOnKeyPress(ToggleProfilerOverlay);
+			keys[GLFW_KEY_T].SetOnKeyPress(CaptureTrace);
+			keys[GLFW_KEY_G].SetOnKeyPress(LogMemoryUsage);
+			keys[GLFW_KEY_C].SetOnKeyPress(SaveImage);
 		}
 	}
 
@@ -238,6 +254,7 @@ namespace PT::Input
 
 	void Init(const Settings& settings, Window& window)
 	{
+		PROFILE_FUNCTION();
 		LOG_INFO("Initializing the Input System...\n");
 		InitKeys();
 		InitButtons();
@@ -257,6 +274,7 @@ namespace PT::Input
 
 	void Update(const float& deltaTime)
 	{
+		PROFILE_FUNCTION();
 		s_deltaTime = deltaTime;
 		if (!commandQueue.empty())
 		{
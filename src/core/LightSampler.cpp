@@ -0,0 +1,287 @@
+#include <PT.h>
+#include "LightSampler.h"
+#include "Profiler.h"
+
+namespace PT
+{
+	namespace
+	{
+		constexpr uint32_t nBuckets = 12;
+
+		// Trails hold one bit per level, no leaf may sit deeper than this
+		constexpr uint32_t maxTrailDepth = 32;
+
+		// Past this depth nodes split by count
+		constexpr uint32_t maxSAOHDepth = 16;
+
+		uint32_t CeilLog2(size_t n)
+		{
+			uint32_t log = 0;
+			while ((size_t(1) << log) < n)
+				++log;
+			return log;
+		}
+
+		// Smallest cone holding both cones, a cosine of -1 stands for the whole sphere of directions
+		void UnionCone(glm::vec3& axis, float& cosTheta, const glm::vec3& otherAxis, const float& otherCosTheta)
+		{
+			float theta = std::acos(glm::clamp(cosTheta, -1.0f, 1.0f));
+			float otherTheta = std::acos(glm::clamp(otherCosTheta, -1.0f, 1.0f));
+			float thetaD = glm::angle(axis, otherAxis);
+
+			// One cone already holds the other
+			if (std::min(thetaD + otherTheta, glm::pi<float>()) <= theta)
+				return;
+			if (std::min(thetaD + theta, glm::pi<float>()) <= otherTheta)
+			{
+				axis = otherAxis;
+				cosTheta = otherCosTheta;
+				return;
+			}
+
+			float thetaO = 0.5f * (theta + thetaD + otherTheta);
+			glm::vec3 rotationAxis = glm::cross(axis, otherAxis);
+			if (thetaO >= glm::pi<float>() || glm::dot(rotationAxis, rotationAxis) == 0.0f)
+			{
+				cosTheta = -1.0f;
+				return;
+			}
+
+			// Rotate the axis toward the other one so the new cone touches both (Rodrigues' formula)
+			float thetaR = thetaO - theta;
+			glm::vec3 k = glm::normalize(rotationAxis);
+			axis = glm::normalize(axis * std::cos(thetaR) + glm::cross(k, axis) * std::sin(thetaR) + k * glm::dot(k, axis) * (1.0f - std::cos(thetaR)));
+			cosTheta = std::cos(thetaO);
+		}
+
+		// Surface area orientation heuristic cost of a group of lights (Conty Estevez and Kulla 2018)
+		float SAOHCost(const LightBounds& lb, const Bounds& nodeBounds, const uint32_t& dim)
+		{
+			float thetaO = std::acos(glm::clamp(lb.cosThetaO, -1.0f, 1.0f));
+			float thetaE = std::acos(glm::clamp(lb.cosThetaE, -1.0f, 1.0f));
+			float thetaW = std::min(thetaO + thetaE, glm::pi<float>());
+			float sinThetaO = std::sqrt(std::max(0.0f, 1.0f - lb.cosThetaO * lb.cosThetaO));
+			float MOmega = 2.0f * glm::pi<float>() * (1.0f - lb.cosThetaO) +
+						   0.5f * glm::pi<float>() * (2.0f * thetaW * sinThetaO - std::cos(thetaO - 2.0f * thetaW) - 2.0f * thetaO * sinThetaO + lb.cosThetaO);
+
+			// Penalize thin slabs along the split dimension
+			glm::vec3 d = nodeBounds.Diagonal();
+			float Kr = std::max(d.x, std::max(d.y, d.z)) / std::max(d[dim], std::numeric_limits<float>::min());
+
+			return lb.phi * MOmega * Kr * lb.bounds.SurfaceArea();
+		}
+	}
+
+	glm::vec3 LightBounds::Centroid() const
+	{
+		return 0.5f * (bounds.min + bounds.max);
+	}
+
+	void LightBounds::Union(const LightBounds& other)
+	{
+		if (other.phi == 0.0f)
+			return;
+		if (phi == 0.0f)
+		{
+			*this = other;
+			return;
+		}
+
+		bounds.Union(other.bounds);
+		phi += other.phi;
+		UnionCone(axis, cosThetaO, other.axis, other.cosThetaO);
+		cosThetaE = std::min(cosThetaE, other.cosThetaE);
+		twoSided = twoSided || other.twoSided;
+	}
+
+	LightBounds GetLightBounds(const SphereLight& light)
+	{
+		// Spheres emit in every direction
+		LightBounds lb;
+		lb.bounds.min = light.worldPos - glm::vec3(light.radius);
+		lb.bounds.max = light.worldPos + glm::vec3(light.radius);
+		lb.phi = (0.3f * light.emittance.x + 0.6f * light.emittance.y + 0.1f * light.emittance.z) * light.area;
+		lb.cosThetaO = -1.0f;
+		lb.cosThetaE = 0.0f;
+		return lb;
+	}
+
+	LightBounds GetLightBounds(const TriangleLight& light)
+	{
+		// Emission leaves both faces within a hemisphere around the normal, degenerate triangles emit nothing
+		LightBounds lb;
+		glm::vec3 n = glm::cross(light.p1 - light.p0, light.p2 - light.p0);
+		if (light.area <= 0.0f)
+			return lb;
+
+		lb.bounds.min = glm::min(light.p0, glm::min(light.p1, light.p2));
+		lb.bounds.max = glm::max(light.p0, glm::max(light.p1, light.p2));
+		lb.axis = glm::normalize(n);
+		lb.phi = (0.3f * light.emission.x + 0.6f * light.emission.y + 0.1f * light.emission.z) * light.area * 2.0f;
+		lb.cosThetaO = 1.0f;
+		lb.cosThetaE = 0.0f;
+		lb.twoSided = true;
+		return lb;
+	}
+
+	void LightSampler::Build(const std::vector<LightBounds>& lights)
+	{
+		PROFILE_FUNCTION();
+		gpuNodes.clear();
+		gpuEntries.assign(lights.size(), GPULightEntry{ 0.0f, 0, 0.0f, 0 });
+
+		BuildAliasTable(lights);
+
+		// Lights that emit nothing are left out of the BVH, their pmf stays zero
+		std::vector<uint32_t> indices;
+		for (uint32_t i = 0; i < lights.size(); ++i)
+			if (lights[i].phi > 0.0f)
+				indices.push_back(i);
+
+		if (!indices.empty())
+			BuildNode(lights, indices, 0, indices.size(), 0, 0);
+	}
+
+	// Vose's alias method over the light powers
+	void LightSampler::BuildAliasTable(const std::vector<LightBounds>& lights)
+	{
+		const size_t n = lights.size();
+		if (n == 0)
+			return;
+
+		double sum = 0.0;
+		for (const LightBounds& lb : lights)
+			sum += lb.phi;
+
+		std::vector<double> scaled(n);
+		std::vector<uint32_t> small, large;
+		for (uint32_t i = 0; i < n; ++i)
+		{
+			gpuEntries[i].pmf = sum > 0.0 ? float(lights[i].phi / sum) : 1.0f / float(n);
+			scaled[i] = (sum > 0.0 ? lights[i].phi / sum : 1.0 / double(n)) * double(n);
+			(scaled[i] < 1.0 ? small : large).push_back(i);
+		}
+
+		while (!small.empty() && !large.empty())
+		{
+			uint32_t s = small.back(); small.pop_back();
+			uint32_t l = large.back(); large.pop_back();
+
+			gpuEntries[s].aliasProb = float(scaled[s]);
+			gpuEntries[s].alias = l;
+
+			scaled[l] -= 1.0 - scaled[s];
+			(scaled[l] < 1.0 ? small : large).push_back(l);
+		}
+
+		// Leftovers are one up to rounding
+		for (uint32_t i : small) { gpuEntries[i].aliasProb = 1.0f; gpuEntries[i].alias = i; }
+		for (uint32_t i : large) { gpuEntries[i].aliasProb = 1.0f; gpuEntries[i].alias = i; }
+	}
+
+	uint32_t LightSampler::BuildNode(const std::vector<LightBounds>& lights, std::vector<uint32_t>& indices, size_t begin, size_t end, uint32_t trail, uint32_t depth)
+	{
+		uint32_t nodeIdx = uint32_t(gpuNodes.size());
+		gpuNodes.emplace_back();
+
+		LightBounds nodeBounds;
+		for (size_t i = begin; i < end; ++i)
+			nodeBounds.Union(lights[indices[i]]);
+
+		uint32_t secondChildOrLight;
+		uint32_t isLeaf;
+		if (end - begin == 1)
+		{
+			secondChildOrLight = indices[begin];
+			isLeaf = 1;
+			gpuEntries[indices[begin]].trail = trail;
+		}
+		else
+		{
+			// SAOH splits may be uneven, only take them while an even split of the node's lights still ends
+			// within maxTrailDepth so any number of lights keeps its trails in 32 bits
+			bool saoh = depth < maxSAOHDepth && depth + CeilLog2(end - begin) < maxTrailDepth;
+			size_t mid = saoh ? SAOHSplit(lights, indices, begin, end) : (begin + end) / 2;
+			BuildNode(lights, indices, begin, mid, trail, depth + 1);
+			secondChildOrLight = BuildNode(lights, indices, mid, end, trail | (1u << depth), depth + 1);
+			isLeaf = 0;
+		}
+
+		// Children were appended after this node, fill it in place now
+		GPULightNode& node = gpuNodes[nodeIdx];
+		node.boundMin = nodeBounds.bounds.min;
+		node.boundMax = nodeBounds.bounds.max;
+		node.phi = nodeBounds.phi;
+		node.axis = nodeBounds.axis;
+		node.cosThetaO = nodeBounds.cosThetaO;
+		node.cosThetaE = nodeBounds.cosThetaE;
+		node.secondChildOrLight = secondChildOrLight;
+		node.isLeaf = isLeaf;
+		node.twoSided = nodeBounds.twoSided ? 1 : 0;
+		node._pad = 0;
+
+		return nodeIdx;
+	}
+
+	// Bucketed split minimizing the SAOH cost, falls back to an even split by count
+	size_t LightSampler::SAOHSplit(const std::vector<LightBounds>& lights, std::vector<uint32_t>& indices, size_t begin, size_t end) const
+	{
+		Bounds nodeBounds, centroidBounds;
+		for (size_t i = begin; i < end; ++i)
+		{
+			glm::vec3 c = lights[indices[i]].Centroid();
+			nodeBounds.Union(lights[indices[i]].bounds);
+			centroidBounds.Union(Bounds{ c, c });
+		}
+
+		float bestCost = std::numeric_limits<float>::max();
+		uint32_t bestDim = 0, bestBucket = 0;
+		glm::vec3 extent = centroidBounds.Diagonal();
+
+		auto BucketOf = [&](const uint32_t& light, const uint32_t& dim)
+		{
+			float offset = (lights[light].Centroid()[dim] - centroidBounds.min[dim]) / extent[dim];
+			return std::min(uint32_t(offset * nBuckets), nBuckets - 1);
+		};
+
+		for (uint32_t dim = 0; dim < 3; ++dim)
+		{
+			if (extent[dim] <= 0.0f)
+				continue;
+
+			std::array<LightBounds, nBuckets> buckets;
+			for (size_t i = begin; i < end; ++i)
+				buckets[BucketOf(indices[i], dim)].Union(lights[indices[i]]);
+
+			for (uint32_t split = 1; split < nBuckets; ++split)
+			{
+				LightBounds below, above;
+				for (uint32_t b = 0; b < split; ++b)
+					below.Union(buckets[b]);
+				for (uint32_t b = split; b < nBuckets; ++b)
+					above.Union(buckets[b]);
+
+				if (below.phi == 0.0f || above.phi == 0.0f)
+					continue;
+
+				float cost = SAOHCost(below, nodeBounds, dim) + SAOHCost(above, nodeBounds, dim);
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestDim = dim;
+					bestBucket = split;
+				}
+			}
+		}
+
+		if (bestCost < std::numeric_limits<float>::max())
+		{
+			auto mid = std::partition(indices.begin() + begin, indices.begin() + end, [&](const uint32_t& light) { return BucketOf(light, bestDim) < bestBucket; });
+			size_t split = size_t(mid - indices.begin());
+			if (split != begin && split != end)
+				return split;
+		}
+
+		return (begin + end) / 2;
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "Logger.h"
+#include "Entity.h"
+#include "Mesh.h"
+
+namespace PT
+{
+	// Spatial and directional extent of one light or a group of them. Emission leaves within thetaE
+	// of a direction inside the cone of half angle thetaO around axis, phi is the emitted power.
+	struct LightBounds
+	{
+		Bounds bounds;
+		glm::vec3 axis	= glm::vec3(0.0f, 0.0f, 1.0f);
+		float phi		= 0.0f;
+		float cosThetaO = 1.0f;
+		float cosThetaE = 1.0f;
+		bool twoSided	= false;
+
+		glm::vec3 Centroid() const;
+		void Union(const LightBounds& other);
+	};
+
+	LightBounds GetLightBounds(const SphereLight& light);
+	LightBounds GetLightBounds(const TriangleLight& light);
+
+	// Node of the light BVH in preorder, the first child follows its parent. Leaves hold a single light.
+	struct alignas(16) GPULightNode
+	{
+		alignas(16) glm::vec3 boundMin;
+		alignas(4)  float phi;
+		alignas(16) glm::vec3 boundMax;
+		alignas(4)  uint32_t secondChildOrLight;
+		alignas(16) glm::vec3 axis;
+		alignas(4)  float cosThetaO;
+		alignas(4)  float cosThetaE;
+		alignas(4)  uint32_t isLeaf;
+		alignas(4)  uint32_t twoSided;
+		alignas(4)  uint32_t _pad;
+	};
+
+	// Per light alias table entry and power pmf, trail holds the light's path from the BVH root (bit i set = second child at depth i)
+	struct alignas(16) GPULightEntry
+	{
+		alignas(4) float aliasProb;
+		alignas(4) uint32_t alias;
+		alignas(4) float pmf;
+		alignas(4) uint32_t trail;
+	};
+
+	// Builds the light sampling structures, a power proportional alias table and a light BVH
+	class LightSampler
+	{
+		public:
+			explicit LightSampler() = default;
+			void Build(const std::vector<LightBounds>& lights);
+
+		public:
+			std::vector<GPULightNode> gpuNodes;
+			std::vector<GPULightEntry> gpuEntries;
+
+		private:
+			void BuildAliasTable(const std::vector<LightBounds>& lights);
+			uint32_t BuildNode(const std::vector<LightBounds>& lights, std::vector<uint32_t>& indices, size_t begin, size_t end, uint32_t trail, uint32_t depth);
+			size_t SAOHSplit(const std::vector<LightBounds>& lights, std::vector<uint32_t>& indices, size_t begin, size_t end) const;
+	};
+}
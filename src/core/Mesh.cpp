@@ -1,244 +1,13 @@
 #include <PT.h>
 #include "Mesh.h"
+#include "Profiler.h"
 
 namespace PT
 {
-	glm::vec3 Bounds::Diagonal() const
-	{
-		return glm::clamp(max - min, 0.0f, std::numeric_limits<float>::max());
-	}
-
-	float Bounds::SurfaceArea() const
-	{
-		glm::vec3 d = Diagonal();
-		return 2.0f * (d.x * d.y + d.x * d.z + d.y * d.z);
-	}
-
-	void Bounds::Union(const Bounds& other)
-	{
-		this->min = glm::vec3(std::min(this->min.x, other.min.x),
-							  std::min(this->min.y, other.min.y),
-							  std::min(this->min.z, other.min.z));
-
-		this->max = glm::vec3(std::max(this->max.x, other.max.x),
-							  std::max(this->max.y, other.max.y),
-							  std::max(this->max.z, other.max.z));
-	}
-
-	BVHNode::BVHNode(std::vector<Triangle>& triangles) : depth(0),
-						 nChild(0),
-						 isLeaf(true), 
-						 left(nullptr), 
-						 right(nullptr) 
-	{
-		
-		for (uint32_t i = 0; i < triangles.size(); ++i)
-		{
-			this->primitives.push_back(&triangles[i]);
-		}
-	}
-
-	BVHNode::BVHNode(uint32_t&& t_depth) : depth(t_depth),
-										   nChild(0),
-										   isLeaf(true),
-										   left(nullptr),
-										   right(nullptr) {}
-
-	BVHNode::~BVHNode()
-	{
-		if (this->left)
-			delete(this->left);
-		if (this->right) 
-			delete(this->right);
-	}
-
-	void BVHNode::FindBounds()
-	{
-		for (Triangle* i : primitives)
-		{
-			this->bounds.Union(i->bounds);
-		}
-	}
-
-	void BVHNode::Subdivide()
-	{
-		if (this->primitives.size() <= minPrimitives)
-			return;
-
-		this->left = new BVHNode(this->depth + 1);
-		this->right = new BVHNode(this->depth + 1);
-
-		this->nChild += 2;
-
-		Partition();
-
-		// Empty child, so this node couldn't be partitioned any further. Return it as a leaf instead
-		if (this->left->primitives.size() == 0 || this->right->primitives.size() == 0)
-		{
-			this->nChild = 0;
-			delete(this->left);
-			delete(this->right);
-			this->left = nullptr;
-			this->right = nullptr;
-			return;
-		}
-
-		this->left->FindBounds();
-		this->right->FindBounds();
-
-		this->left->Subdivide();
-		this->right->Subdivide();
-
-		this->nChild += left->nChild + right->nChild;
-		this->isLeaf = false;
-	}
-
-	void BVHNode::Partition()
-	{
-		std::vector<Triangle*>::iterator ptr = SAHSplit();
-
-		for (auto i = this->primitives.begin(); i < ptr; ++i)
-		{
-			this->left->primitives.emplace_back(*i);
-		}
-
-		for (auto i = ptr; i != this->primitives.end(); ++i)
-		{
-			this->right->primitives.emplace_back(*i);
-		}
-	}
-
-
-	GPUBVHNode::GPUBVHNode(const BVHNode* node, uint32_t& n, const uint32_t& idx) : nPrimitives(0)
-	{
-		this->boundMin = node->bounds.min;
-		this->boundMax = node->bounds.max;
-	
-		// Leaf node
-		if (node->isLeaf)
-		{
-			this->secondChildOffset = n;
-			this->nPrimitives = node->primitives.size();
-			n += this->nPrimitives;
-		}
-		// Parent node
-		else
-		{
-			this->secondChildOffset = idx + node->left->nChild + 2;
-			this->nPrimitives = 0;
-		}
-	}
-
-	glm::vec3 BVHNode::Offset(const glm::vec3& point) const
-	{
-		glm::vec3 offset = point - this->bounds.min;
-
-		if (this->bounds.max.x >= point.x)
-			offset.x /= this->bounds.max.x - this->bounds.min.x;
-		if (this->bounds.max.y >= point.y)
-			offset.y /= this->bounds.max.y - this->bounds.min.y;
-		if (this->bounds.max.z >= point.z)
-			offset.z /= this->bounds.max.z - this->bounds.min.z;
-
-		return offset;
-	}
-
-	// As per PBR Book - Chapter 4.3
-	std::vector<Triangle*>::iterator BVHNode::SAHSplit()
-	{
-		const size_t naxis = 3;
-		const size_t nbins = 16;
-
-		struct Bin
-		{
-			uint32_t count = 0;
-			Bounds bounds;
-		} bins[naxis][nbins];
-
-		// See where each primitive lands on each bin
-		for (size_t axis = 0; axis < naxis; ++axis) 
-		{
-			for (Triangle* i : this->primitives)
-			{
-				uint32_t bidx = uint32_t(nbins * Offset(i->centroid)[axis]);
-
-				if (bidx == nbins)
-					bidx = nbins - 1;
-
-				bins[axis][bidx].count++;
-				bins[axis][bidx].bounds.Union(i->bounds);
-			}
-		}
-
-		// Calculate all bins costs
-		float cost[naxis][nbins - 1];
-
-		for (size_t axis = 0; axis < naxis; ++axis)
-		{
-			for (size_t i = 0; i < nbins - 1; ++i)
-			{
-				Bounds lower, upper;
-				uint32_t countLower = 0;
-				uint32_t countUpper = 0;
-
-				for (size_t j = 0; j <= i; ++j)
-				{
-					lower.Union(bins[axis][j].bounds);
-					countLower += bins[axis][j].count;
-				}
-
-				for (size_t j = i + 1; j < nbins; ++j)
-				{
-					upper.Union(bins[axis][j].bounds);
-					countUpper += bins[axis][j].count;
-				}
-
-				cost[axis][i] = 0.125f + (countLower * lower.SurfaceArea() + countUpper * upper.SurfaceArea()) / this->bounds.SurfaceArea();
-			}
-		}
-
-		// Find the split with the minimum cost
-		float minCost = cost[0][0];
-		size_t minCostSplitBin = 0, minCostAxis = 0;
-
-		for (size_t axis = 0; axis < naxis; ++axis)
-		{
-			for (size_t i = 1; i < nbins - 1; ++i)
-			{
-				if (cost[axis][i] < minCost)
-				{
-					minCost = cost[axis][i];
-					minCostSplitBin = i;
-					minCostAxis = axis;
-				}
-			}
-		}
-
-		// Rearrange primitives according to the best split
-		std::vector<Triangle*>::iterator ptr;
-		float leafCost = float(this->primitives.size());
-
-		// Splitting is not worth it, just turn this node into a leaf
-		if (leafCost < minCost && this->primitives.size() > minPrimitives)
-			ptr = this->primitives.end();
-		// Split this node
-		else
-			ptr = std::partition(this->primitives.begin(), this->primitives.end(), [&](Triangle* t)
-				{
-					uint32_t bidx = uint32_t(nbins * Offset(t->centroid)[minCostAxis]);
-					
-					if (bidx == nbins)
-						bidx = nbins - 1;
-
-					return bidx <= minCostSplitBin;
-				});
-
-		return ptr;
-	}
-
 	// TODO: Change to fetch this data from the file
 	Model::Model(const std::string&& filePath, Transform& transform, uint32_t&& matid)
 	{
+		PROFILE_FUNCTION();
 		LOG_INFO("Loading model at (", filePath, ")...");
 
 		this->transform = transform;
@@ -246,7 +15,11 @@ namespace PT
 
 		// Load OBJ model and its meshes
 		objl::Loader loader;
-		bool loadout = loader.LoadFile(filePath);
+		bool loadout;
+		{
+			PROFILE_SCOPE("OBJ parse");
+			loadout = loader.LoadFile(filePath);
+		}
 
 		if (loadout)
 		{
@@ -334,37 +107,22 @@ namespace PT
 
 	void Model::BuildBVH()
 	{
-		// Host side BVH
-		BVHNode* root = new BVHNode(this->triangles);
-		root->FindBounds();
-		root->Subdivide();
-		
-		// Convert it to a linear layout for GPU traversal
-		std::stack<BVHNode*> visited;
-		visited.push(root);
-		uint32_t n = 0;
-		uint32_t ind = 0;
-
-		while (!visited.empty())
+		PROFILE_FUNCTION();
+		std::vector<Primitive> primitives(this->triangles.size());
+		for (uint32_t i = 0; i < this->triangles.size(); ++i)
 		{
-			BVHNode* current = visited.top();
-			this->gpuNodes.emplace_back(std::move(GPUBVHNode(current, n, ind++)));
-			visited.pop();
+			primitives[i].bounds = this->triangles[i].bounds;
+			primitives[i].centroid = this->triangles[i].centroid;
+			primitives[i].type = PrimitiveType::Triangle;
+			primitives[i].index = i;
+		}
 
-			if (current->right)
-				visited.push(current->right);
-			if (current->left)
-				visited.push(current->left);
+		std::vector<const Primitive*> order;
+		BuildFlatBVH(primitives, this->gpuNodes, order);
 
-			if (current->isLeaf)
-			{
-				for (Triangle* i : current->primitives)
-				{
-					this->gpuTriangles.emplace_back(std::move(GPUTriangle(i->verts)));
-				}
-			}
+		for (const Primitive* i : order)
+		{
+			this->gpuTriangles.emplace_back(std::move(GPUTriangle(this->triangles[i->index].verts)));
 		}
-
-		delete root;
 	}
-}
\ No newline at end of file
+}
@@ -1,23 +1,14 @@
 #pragma once
-#include "Logger.h"
+#include "BVH.h"
 
 #define MAX_TRIANGLES 100000
 #define MAX_NODES	  100000
+#define NO_LIGHT	  0xFFFFFFFFu
 
 namespace PT
 {	
 	using Index = uint32_t;
 
-	struct Bounds
-	{
-		glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
-		glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
-
-		glm::vec3 Diagonal() const;
-		float SurfaceArea() const;
-		void Union(const Bounds& other);
-	};
-
 	struct alignas(16) Vertex
 	{
 		alignas(16) glm::vec3 localPos = glm::vec3(0.0f);
@@ -52,45 +43,6 @@ namespace PT
 		std::vector<Index> indices;
 	};
 
-	enum class SplitAxis { X, Y, Z };
-	
-	constexpr uint32_t minPrimitives = 2;
-
-	class BVHNode
-	{
-		public:
-			BVHNode(std::vector<Triangle>& triangles);
-			BVHNode(uint32_t&& t_depth);
-			~BVHNode();
-
-			void FindBounds();
-			void Subdivide();
-			void Partition();
-
-		public:
-			bool isLeaf;
-			uint32_t depth;
-			uint32_t nChild;
-			Bounds bounds;
-			std::vector<Triangle*> primitives;
-			BVHNode* left;
-			BVHNode* right;
-
-		private:
-			glm::vec3 Offset(const glm::vec3& point) const;
-			std::vector<Triangle*>::iterator SAHSplit();
-	};
-
-	struct alignas(16) GPUBVHNode
-	{
-		explicit GPUBVHNode(const BVHNode * node, uint32_t & n, const uint32_t & idx);
-
-		alignas(16) glm::vec3 boundMin;
-		alignas(4)  uint32_t secondChildOffset;
-		alignas(16) glm::vec3 boundMax;
-		alignas(4)  uint32_t nPrimitives;
-	};
-
 	class Model
 	{
 		public:
@@ -108,6 +60,9 @@ namespace PT
 			std::vector<GPUTriangle> gpuTriangles;
 			std::vector<GPUBVHNode> gpuNodes;
 			uint32_t matid;
+
+			// First entry of the model's triangles in the scene's triangle lights, NO_LIGHT unless its material emits
+			uint32_t lightOffset = NO_LIGHT;
 	};
 
 	struct alignas(16) GPUModel
@@ -117,6 +72,7 @@ namespace PT
 		GPUTriangle triangles[MAX_TRIANGLES];
 		GPUBVHNode bvhnodes[MAX_NODES];
 		uint32_t matid;
-		uint32_t _pad[3];
+		uint32_t lightOffset;
+		uint32_t _pad[2];
 	};
 }
\ No newline at end of file
@@ -3,7 +3,7 @@
 
 namespace PT
 {
-	Timer::Timer() : m_nSamples(0), m_mean(0.0) {}
+	Timer::Timer() : m_nSamples(0), m_mean(0.0), m_last(0.0) {}
 
 	void Timer::Stop()
 	{
@@ -17,6 +17,7 @@ namespace PT
 
 		m_nSamples++;
 		m_mean += ms;
+		m_last = ms;
 	}
 
 	void Timer::Start()
@@ -28,4 +29,467 @@ namespace PT
 	{
 		return double(m_mean / m_nSamples);
 	}
+
+	double Timer::GetLast() const
+	{
+		return m_last;
+	}
+
+	std::chrono::time_point<std::chrono::high_resolution_clock> Timer::GetStartPoint() const
+	{
+		return m_startPoint;
+	}
+
+	namespace Trace
+	{
+		namespace
+		{
+			struct TraceEvent
+			{
+				const char* name;
+				int64_t start;		// Microseconds since the trace epoch
+				int64_t duration;
+			};
+
+			// Events are published by storing the count after writing them, the collector reads up to the count
+			struct TraceChunk
+			{
+				static constexpr uint32_t s_size = 1024;
+				TraceEvent events[s_size];
+				std::atomic<uint32_t> count{ 0 };
+				std::atomic<TraceChunk*> next{ nullptr };
+			};
+
+			// Only the owning thread writes to its buffer, the capturing thread reads it without locking. A thread
+			// rewinds its buffer itself when it records the first zone of a new capture, and the buffer is only
+			// collected once it holds the capture being ended. Chunks are kept and reused across captures.
+			struct ThreadBuffer
+			{
+				uint32_t tid;
+				std::atomic<uint32_t> capture{ 0 };
+				TraceChunk first;
+				TraceChunk* current = &first;
+			};
+
+			const auto epoch = std::chrono::high_resolution_clock::now();
+			std::atomic<bool> capturing{ false };
+			std::atomic<uint32_t> captureId{ 0 };
+			std::atomic<uint32_t> nextTid{ 0 };
+
+			// Buffers are never freed, a thread may finish before the capture is written
+			std::mutex registryMutex;
+			std::vector<ThreadBuffer*> registry;
+
+			ThreadBuffer& LocalBuffer()
+			{
+				thread_local ThreadBuffer* buffer = nullptr;
+				if (!buffer)
+				{
+					buffer = new ThreadBuffer();
+					buffer->tid = nextTid++;
+
+					std::lock_guard<std::mutex> lock(registryMutex);
+					registry.push_back(buffer);
+				}
+				return *buffer;
+			}
+		}
+
+		void BeginCapture()
+		{
+			// Ids start at one, a buffer that never recorded holds capture zero
+			++captureId;
+			capturing = true;
+		}
+
+		void EndCapture(const std::string& path)
+		{
+			capturing = false;
+
+			// A zone recorded concurrently is either published before its chunk is read or left out. Buffers only
+			// rewind for a newer capture, which can't begin before this returns.
+			const uint32_t capture = captureId;
+			std::vector<std::pair<uint32_t, std::vector<TraceEvent>>> threads;
+			{
+				std::lock_guard<std::mutex> lock(registryMutex);
+				for (ThreadBuffer* buffer : registry)
+				{
+					std::vector<TraceEvent> events;
+					if (buffer->capture.load(std::memory_order_acquire) == capture)
+					{
+						for (TraceChunk* chunk = &buffer->first; chunk; chunk = chunk->next.load(std::memory_order_acquire))
+						{
+							uint32_t count = chunk->count.load(std::memory_order_acquire);
+							events.insert(events.end(), chunk->events, chunk->events + count);
+						}
+					}
+					threads.emplace_back(buffer->tid, std::move(events));
+				}
+			}
+
+			std::ofstream file(path);
+			if (!file.is_open())
+			{
+				LOG_WARNING("Failed to write the trace to: ", path, "\n");
+				return;
+			}
+
+			size_t nEvents = 0;
+			bool first = true;
+			file << "{\n\"displayTimeUnit\": \"ms\",\n\"traceEvents\": [\n";
+			for (const auto& [tid, events] : threads)
+			{
+				file << (first ? "" : ",\n") << "{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << tid
+					 << ", \"args\": { \"name\": \"" << (tid == 0 ? "main" : "thread " + std::to_string(tid)) << "\" } }";
+				first = false;
+
+				for (const TraceEvent& event : events)
+				{
+					file << ",\n{ \"name\": \"" << event.name << "\", \"cat\": \"PT\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << tid
+						 << ", \"ts\": " << event.start << ", \"dur\": " << event.duration << " }";
+				}
+				nEvents += events.size();
+			}
+			file << "\n]\n}\n";
+
+			LOG_INFO("Trace with ", nEvents, " zones written to ", path, "\n");
+		}
+
+		bool IsCapturing()
+		{
+			return capturing.load(std::memory_order_relaxed);
+		}
+
+		uint32_t GetCaptureId()
+		{
+			return captureId.load(std::memory_order_relaxed);
+		}
+
+		void Record(const char* name, const Timer& timer, const uint32_t& capture)
+		{
+			int64_t start = std::chrono::duration_cast<std::chrono::microseconds>(timer.GetStartPoint() - epoch).count();
+
+			if (!capturing || capture != captureId)
+				return;
+
+			// The first zone of a capture on this thread drops the events of the previous one
+			ThreadBuffer& buffer = LocalBuffer();
+			if (buffer.capture.load(std::memory_order_relaxed) != capture)
+			{
+				for (TraceChunk* chunk = &buffer.first; chunk; chunk = chunk->next.load(std::memory_order_relaxed))
+					chunk->count.store(0, std::memory_order_relaxed);
+				buffer.current = &buffer.first;
+				buffer.capture.store(capture, std::memory_order_release);
+			}
+
+			TraceChunk* chunk = buffer.current;
+			uint32_t count = chunk->count.load(std::memory_order_relaxed);
+			if (count == TraceChunk::s_size)
+			{
+				TraceChunk* next = chunk->next.load(std::memory_order_relaxed);
+				if (!next)
+				{
+					next = new TraceChunk();
+					chunk->next.store(next, std::memory_order_release);
+				}
+				buffer.current = chunk = next;
+				count = 0;
+			}
+
+			chunk->events[count] = { name, start, int64_t(timer.GetLast() * 1000.0) };
+			chunk->count.store(count + 1, std::memory_order_release);
+		}
+	}
+
+	ProfileScope::ProfileScope(const char* name) : m_name(name), m_active(Trace::IsCapturing()), m_capture(Trace::GetCaptureId())
+	{
+		if (m_active)
+			m_timer.Start();
+	}
+
+	ProfileScope::~ProfileScope()
+	{
+		if (!m_active)
+			return;
+
+		m_timer.Stop();
+		Trace::Record(m_name, m_timer, m_capture);
+	}
+
+	GPUTimer::GPUTimer() : m_ringSize(0), m_head(0), m_tail(0), m_last(0.0), m_total(0.0), m_count(0) {}
+
+	GPUTimer::~GPUTimer()
+	{
+		if (!m_queries.empty())
+			glDeleteQueries(GLsizei(m_queries.size()), m_queries.data());
+	}
+
+	void GPUTimer::Init(const uint32_t& ringSize)
+	{
+		m_ringSize = std::max<uint32_t>(1, ringSize);
+		m_queries.resize(size_t(m_ringSize) * 2);
+		glGenQueries(GLsizei(m_queries.size()), m_queries.data());
+	}
+
+	void GPUTimer::Start()
+	{
+		// Drop the oldest pending measurement instead of stalling when the ring is full
+		ReadResults();
+		if (m_head - m_tail == m_ringSize)
+			++m_tail;
+
+		glQueryCounter(m_queries[(m_head % m_ringSize) * 2], GL_TIMESTAMP);
+	}
+
+	void GPUTimer::Stop()
+	{
+		glQueryCounter(m_queries[(m_head % m_ringSize) * 2 + 1], GL_TIMESTAMP);
+		++m_head;
+	}
+
+	double GPUTimer::GetLast() const
+	{
+		return m_last;
+	}
+
+	double GPUTimer::GetMean() const
+	{
+		return m_count > 0 ? m_total / double(m_count) : 0.0;
+	}
+
+	uint32_t GPUTimer::GetCount() const
+	{
+		return m_count;
+	}
+
+	void GPUTimer::ReadResults()
+	{
+		while (m_tail != m_head)
+		{
+			const GLuint* query = &m_queries[(m_tail % m_ringSize) * 2];
+
+			GLint available = 0;
+			glGetQueryObjectiv(query[1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				break;
+
+			GLuint64 start, end;
+			glGetQueryObjectui64v(query[0], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(query[1], GL_QUERY_RESULT, &end);
+			m_last = double(end - start) * 1e-6;
+			m_total += m_last;
+			++m_count;
+			++m_tail;
+		}
+	}
+
+	StageProfiler::StageProfiler() : m_queries{}, m_queryStage{}, m_head(0), m_tail(0), m_active(false) {}
+
+	StageProfiler::~StageProfiler()
+	{
+		if (m_queries[0])
+			glDeleteQueries(s_ringSize, m_queries);
+	}
+
+	void StageProfiler::Init()
+	{
+		if (!m_queries[0])
+			glGenQueries(s_ringSize, m_queries);
+	}
+
+	void StageProfiler::Begin(const std::string& stage)
+	{
+		if (m_head - m_tail == s_ringSize)
+			Collect();
+		if (m_head - m_tail == s_ringSize)
+			return;
+
+		auto id = m_stageIds.find(stage);
+		if (id == m_stageIds.end())
+		{
+			id = m_stageIds.emplace(stage, uint32_t(m_stages.size())).first;
+			m_stages.push_back({ stage });
+		}
+
+		m_queryStage[m_head % s_ringSize] = id->second;
+		glBeginQuery(GL_TIME_ELAPSED, m_queries[m_head % s_ringSize]);
+		m_active = true;
+	}
+
+	void StageProfiler::End()
+	{
+		if (!m_active)
+			return;
+
+		glEndQuery(GL_TIME_ELAPSED);
+		m_active = false;
+		++m_head;
+	}
+
+	void StageProfiler::Collect()
+	{
+		while (m_tail != m_head)
+		{
+			GLuint query = m_queries[m_tail % s_ringSize];
+
+			GLint available = 0;
+			glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				break;
+
+			GLuint64 elapsed;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+
+			Stage& stage = m_stages[m_queryStage[m_tail % s_ringSize]];
+			double ms = double(elapsed) * 1e-6;
+			stage.recent = stage.histogram.GetCount() ? glm::mix(stage.recent, ms, 0.05) : ms;
+			stage.histogram.Record(ms);
+			++m_tail;
+		}
+	}
+
+	std::vector<StageStats> StageProfiler::GetStats() const
+	{
+		std::vector<StageStats> stats;
+		for (const Stage& stage : m_stages)
+		{
+			StageStats stat;
+			stat.name = stage.name;
+			stat.count = stage.histogram.GetCount();
+			stat.min = stage.histogram.GetMin();
+			stat.avg = stage.histogram.GetMean();
+			stat.p50 = stage.histogram.GetPercentile(50.0);
+			stat.p90 = stage.histogram.GetPercentile(90.0);
+			stat.p99 = stage.histogram.GetPercentile(99.0);
+			stat.max = stage.histogram.GetMax();
+			stats.push_back(stat);
+		}
+		return stats;
+	}
+
+	std::string StageProfiler::GetOverlay() const
+	{
+		std::vector<std::pair<std::string, double>> kinds;
+		for (const Stage& stage : m_stages)
+		{
+			std::string kind = stage.name.substr(0, stage.name.find('/'));
+			auto entry = std::find_if(kinds.begin(), kinds.end(), [&](const auto& k) { return k.first == kind; });
+			if (entry == kinds.end())
+				kinds.push_back({ kind, stage.recent });
+			else
+				entry->second += stage.recent;
+		}
+
+		std::ostringstream overlay;
+		overlay.precision(2);
+		overlay << std::fixed;
+		for (const auto& kind : kinds)
+			overlay << " | " << kind.first << " " << kind.second;
+		if (!kinds.empty())
+			overlay << " [ms]";
+		return overlay.str();
+	}
+
+	void StageProfiler::WriteCSV(const std::string& path) const
+	{
+		std::ofstream file(path);
+		if (!file.is_open())
+		{
+			LOG_WARNING("Failed to write the stage profile to: ", path, "\n");
+			return;
+		}
+
+		file << "stage,count,min_ms,avg_ms,p50_ms,p90_ms,p99_ms,max_ms\n";
+		for (const StageStats& stat : GetStats())
+		{
+			file << stat.name << "," << stat.count << "," << stat.min << "," << stat.avg << "," << stat.p50 << ","
+				 << stat.p90 << "," << stat.p99 << "," << stat.max << "\n";
+		}
+	}
+
+	void StageProfiler::WriteJSON(const std::string& path) const
+	{
+		std::ofstream file(path);
+		if (!file.is_open())
+		{
+			LOG_WARNING("Failed to write the stage profile to: ", path, "\n");
+			return;
+		}
+
+		std::vector<StageStats> stats = GetStats();
+		file << "{\n\t\"stages\": [\n";
+		for (size_t i = 0; i < stats.size(); ++i)
+		{
+			file << "\t\t{ \"name\": \"" << stats[i].name << "\", \"count\": " << stats[i].count << ", \"min_ms\": " << stats[i].min
+				 << ", \"avg_ms\": " << stats[i].avg << ", \"p50_ms\": " << stats[i].p50 << ", \"p90_ms\": " << stats[i].p90
+				 << ", \"p99_ms\": " << stats[i].p99 << ", \"max_ms\": " << stats[i].max << " }" << (i + 1 < stats.size() ? ",\n" : "\n");
+		}
+		file << "\t]\n}\n";
+	}
+
+	FrameStatistics::FrameStatistics() : m_frameTime(1e-2, 1e5), m_samplesPerSecond(1.0, 1e12), m_periodFrameTime(1e-2, 1e5),
+										 m_periodSamplesPerSecond(1.0, 1e12), m_reportInterval(0.0), m_periodTime(0.0) {}
+
+	void FrameStatistics::Init(const double& reportInterval)
+	{
+		m_reportInterval = reportInterval;
+	}
+
+	void FrameStatistics::RecordFrame(const double& frameTime, const double& samplesPerSecond)
+	{
+		m_frameTime.Record(frameTime);
+		m_periodFrameTime.Record(frameTime);
+
+		// Converged frames trace nothing, they would only drag the rate percentiles down
+		if (samplesPerSecond > 0.0)
+		{
+			m_samplesPerSecond.Record(samplesPerSecond);
+			m_periodSamplesPerSecond.Record(samplesPerSecond);
+		}
+
+		m_periodTime += frameTime * 0.001;
+		if (m_reportInterval > 0.0 && m_periodTime >= m_reportInterval)
+			Report();
+	}
+
+	void FrameStatistics::Report()
+	{
+		LOG_INFO("Frame time [ms] p50 ", m_periodFrameTime.GetPercentile(50.0), ", p90 ", m_periodFrameTime.GetPercentile(90.0),
+				 ", p99 ", m_periodFrameTime.GetPercentile(99.0), ", max ", m_periodFrameTime.GetMax(), " over ", m_periodFrameTime.GetCount(), " frames\n");
+		if (m_periodSamplesPerSecond.GetCount())
+		{
+			LOG_INFO("Samples/s p50 ", m_periodSamplesPerSecond.GetPercentile(50.0), ", p10 ", m_periodSamplesPerSecond.GetPercentile(10.0),
+					 ", min ", m_periodSamplesPerSecond.GetMin(), "\n");
+		}
+
+		m_periodFrameTime.Reset();
+		m_periodSamplesPerSecond.Reset();
+		m_periodTime = 0.0;
+	}
+
+	void FrameStatistics::LogSummary() const
+	{
+		LOG_INFO("Frame time over the run [ms] p50 ", m_frameTime.GetPercentile(50.0), ", p90 ", m_frameTime.GetPercentile(90.0),
+				 ", p99 ", m_frameTime.GetPercentile(99.0), ", max ", m_frameTime.GetMax(), " over ", m_frameTime.GetCount(), " frames\n");
+	}
+
+	void FrameStatistics::WriteCSV(const std::string& path) const
+	{
+		std::ofstream file(path);
+		if (!file.is_open())
+		{
+			LOG_WARNING("Failed to write the frame statistics to: ", path, "\n");
+			return;
+		}
+
+		file << "metric,count,min,mean,p50,p90,p99,max\n";
+		auto writeRow = [&](const char* metric, const Histogram& histogram)
+		{
+			file << metric << "," << histogram.GetCount() << "," << histogram.GetMin() << "," << histogram.GetMean() << ","
+				 << histogram.GetPercentile(50.0) << "," << histogram.GetPercentile(90.0) << "," << histogram.GetPercentile(99.0) << ","
+				 << histogram.GetMax() << "\n";
+		};
+		writeRow("frame_time_ms", m_frameTime);
+		writeRow("samples_per_second", m_samplesPerSecond);
+	}
 }
\ No newline at end of file
@@ -1,5 +1,14 @@
 #pragma once
 #include "Logger.h"
+#include "Histogram.h"
+
+#define PROFILE_CONCAT_IMPL(a, b)	a##b
+#define PROFILE_CONCAT(a, b)		PROFILE_CONCAT_IMPL(a, b)
+
+// Records a zone from here to the end of the enclosing scope while a trace capture runs.
+// The name is kept by pointer and must outlive the capture, string literals and __FUNCTION__ do.
+#define PROFILE_SCOPE(name)			PT::ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION()			PROFILE_SCOPE(__FUNCTION__)
 
 namespace PT
 {
@@ -12,11 +21,155 @@ namespace PT
 			void Stop();
 
 			double GetMean();
+			// Duration in milliseconds of the last Start/Stop pair
+			double GetLast() const;
+			std::chrono::time_point<std::chrono::high_resolution_clock> GetStartPoint() const;
 
 		private:
 			std::chrono::time_point<std::chrono::high_resolution_clock> m_startPoint;
 			std::chrono::time_point<std::chrono::high_resolution_clock> m_endPoint;
 			uint32_t m_nSamples;
 			double m_mean;
+			double m_last;
+	};
+
+	// Zones recorded by PROFILE_SCOPE between BeginCapture and EndCapture, written out in the Chrome
+	// trace_event format that Perfetto and chrome://tracing open. Every thread appends to a buffer of its
+	// own without locking, the lock is only taken when a thread records its first zone and on export.
+	namespace Trace
+	{
+		void BeginCapture();
+		// Collects and clears every thread's buffer, zones still open are dropped
+		void EndCapture(const std::string& path);
+		bool IsCapturing();
+		uint32_t GetCaptureId();
+		// Zones are only kept by the capture they started in
+		void Record(const char* name, const Timer& timer, const uint32_t& capture);
+	}
+
+	class ProfileScope final
+	{
+		public:
+			explicit ProfileScope(const char* name);
+			~ProfileScope();
+
+		private:
+			const char* m_name;
+			Timer m_timer;
+			bool m_active;
+			uint32_t m_capture;
+	};
+
+	// Measures GPU execution time with timestamp queries. Results are read back a few frames later
+	// from a ring of query pairs so the CPU never waits on the GPU.
+	class GPUTimer final
+	{
+		public:
+			explicit GPUTimer();
+			~GPUTimer();
+
+			// The ring must hold every measurement started while the oldest one is still in flight,
+			// when it fills up the oldest pending measurement is dropped
+			void Init(const uint32_t& ringSize);
+			void Start();
+			void Stop();
+
+			// Most recent measurement in milliseconds, zero until the first result arrives
+			double GetLast() const;
+			// Mean in milliseconds of every measurement read back so far, zero before the first
+			double GetMean() const;
+			uint32_t GetCount() const;
+
+		private:
+			void ReadResults();
+
+			// Start and end timestamp of each slot, side by side
+			std::vector<GLuint> m_queries;
+			uint32_t m_ringSize;
+			uint32_t m_head;
+			uint32_t m_tail;
+			double m_last;
+			double m_total;
+			uint32_t m_count;
+	};
+
+	struct StageStats
+	{
+		std::string name;
+		double min = 0.0;
+		double avg = 0.0;
+		double p50 = 0.0;
+		double p90 = 0.0;
+		double p99 = 0.0;
+		double max = 0.0;
+		uint64_t count = 0;
+	};
+
+	// Times individual dispatches with GL_TIME_ELAPSED queries. Queries come from a fixed ring and are read
+	// back in the order they were issued once available, a dispatch finding the ring full goes untimed instead
+	// of waiting. Stages are named "kind/index", e.g. "extend/2" for the third bounce's extend dispatch.
+	// Their statistics cover the whole run, the overlay shows a moving average instead.
+	class StageProfiler final
+	{
+		public:
+			explicit StageProfiler();
+			~StageProfiler();
+
+			void Init();
+			void Begin(const std::string& stage);
+			void End();
+
+			// Reads back every finished query, called once per frame
+			void Collect();
+
+			std::vector<StageStats> GetStats() const;
+			// Average milliseconds per batch of each stage kind, summed over its indices
+			std::string GetOverlay() const;
+
+			void WriteCSV(const std::string& path) const;
+			void WriteJSON(const std::string& path) const;
+
+		private:
+			struct Stage
+			{
+				std::string name;
+				Histogram histogram;
+				double recent = 0.0;
+			};
+
+			static constexpr uint32_t s_ringSize = 256;
+			GLuint m_queries[s_ringSize];
+			uint32_t m_queryStage[s_ringSize];
+			uint32_t m_head;
+			uint32_t m_tail;
+			bool m_active;
+
+			std::vector<Stage> m_stages;
+			std::map<std::string, uint32_t> m_stageIds;
+	};
+
+	// Frame time and sampling rate distributions. Each report interval is logged with its own percentiles,
+	// the totals over the whole run are kept for the dump at shutdown.
+	class FrameStatistics final
+	{
+		public:
+			explicit FrameStatistics();
+
+			void Init(const double& reportInterval);
+			// Frame time in milliseconds and pixel samples traced per second during that frame
+			void RecordFrame(const double& frameTime, const double& samplesPerSecond);
+
+			void LogSummary() const;
+			void WriteCSV(const std::string& path) const;
+
+		private:
+			void Report();
+
+			Histogram m_frameTime;
+			Histogram m_samplesPerSecond;
+			Histogram m_periodFrameTime;
+			Histogram m_periodSamplesPerSecond;
+			double m_reportInterval;
+			double m_periodTime;
 	};
 }
\ No newline at end of file
@@ -8,165 +8,797 @@ namespace PT::Renderer
 		Window* window;
 
 		VAO outputVAO;
-		Image outputImg;
 		Image accumulatorImg;
+		Image momentsImg;
 
-		GLBuffer uniformBuffer, dispatchBuffer, atomicBuffer, extend_buffer, shadowBuffer, hitBuffer, pathBuffer;
+		GLBuffer dispatchBuffer, atomicBuffer, extend_buffer, shadowBuffer, hitBuffer, pathBuffer;
 		GLBuffer sceneBuffer;
+		GLBuffer environmentBuffer;
+		GLBuffer sphereLightBuffer, triangleLightBuffer, lightNodeBuffer, lightEntryBuffer;
+		GLBuffer sphereBuffer, analyticNodeBuffer, analyticPrimitiveBuffer;
 		GLBuffer meshBuffer;
+		GLBuffer splatBuffer;
+		GLBuffer activeBuffer;
 
+		// Uniforms are staged on the CPU and uploaded whole through the ring whenever a dispatch needs new values
+		alignas(16) uint8_t uniformData[sizeof(Uniforms)]{};
+		RingBuffer uniformRing;
+
+		// Active pixel counts travel back through a ring of buffers guarded by fences so the CPU never waits.
+		// Pixels only leave the active list between resets, so the latest count bounds the current one.
+		GLBuffer activeReadback[READBACK_RING_SIZE];
+		GLsync activeFence[READBACK_RING_SIZE]{};
+		uint32_t activeEpoch[READBACK_RING_SIZE]{};
+		uint32_t readbackHead = 0;
+		uint32_t readbackTail = 0;
+		uint32_t activePixels = 0;
+		uint32_t epoch = 0;
+
+		// Ray statistics come back through a ring of their own, each slot holds one batch's counters
+		bool rayStats = false;
+		GLBuffer statsBuffer;
+		GLBuffer statsReadback[READBACK_RING_SIZE];
+		GLsync statsFence[READBACK_RING_SIZE]{};
+		uint32_t statsHead = 0;
+		uint32_t statsTail = 0;
+		// Timestamps around the batch whose counters the slot of the same index holds
+		GLuint statsQueries[READBACK_RING_SIZE][2]{};
+		RayStatsReport statsReport;
+		std::string rayStatsOverlay;
+
+		// Both orders of the queue offsets live in the buffer, swapping rebinds the other one
 		GLuint in_offset = 0;
-		GLuint out_offset = MAX_WIDTH * MAX_HEIGHT;
+		GLuint out_offset = 0;
 		GLBuffer uniform_swap;
+		size_t swapStride = 0;
+
+		uint32_t pathsInFlight = 0;
+		uint32_t samplesPerPixel = 1;
+		bool pathRegeneration = false;
+		bool adaptiveSampling = false;
+		bool fusedTraversal = false;
+
+		// Benchmarking times BENCHMARK_BATCHES batches of the wavefront pipeline, then as many of the megakernel
+		RenderMode renderMode = RenderMode::Wavefront;
+		RenderMode batchMode = RenderMode::Wavefront;
+		uint32_t benchmarkBatch = 0;
+		GPUTimer modeTimers[2];
+
+		// The shadow benchmark traces every other batch's shadow rays with the reference connect kernel
+		bool shadowBenchmark = false;
+		bool referenceOcclusion = false;
+		uint32_t shadowBenchmarkBatch = 0;
 
 		ComputeShader generateKernel;
-		ComputeShader extendKernel;
-		ComputeShader shadeKernel;
-		ComputeShader connectKernel;
+		std::map<uint32_t, SceneKernels*> kernelVariants;
+		SceneKernels* kernels = nullptr;
+		std::string kernelDefines;
+		bool lightBVH = true;
 		ComputeShader imageKernel;
+		ComputeShader adaptiveKernel;
 		PixelShader outputKernel;
 
 		AccumulatorProfiler accProfiler;
+		GPUTimer batchTimer;
+		StageProfiler stageProfiler;
+		bool profileStages = false;
+		bool stageProfilingRequested = false;
+		bool profilerOverlay = false;
+		std::string profilerOutput;
+
+		bool headless = false;
+		FrameCapture frameCapture;
+		double autosaveInterval = 0.0;
+		double lastAutosave = 0.0;
+		uint64_t samplesSinceAutosave = 0;
 		uint32_t frame = 0;
+		uint32_t sampleBase = 0;
+		uint32_t batchesThisFrame = 0;
+		uint64_t samplesThisFrame = 0;
+		bool resetThisFrame = false;
 
 		Scene* scene;
 	}
 
 	void Init(const Settings& settings, Window& t_window)
 	{
+		PROFILE_FUNCTION();
 		window = &t_window;
-		
+
+		// Render resolution defaults to the window's, frames larger than the paths in flight budget are tiled
+		uint32_t width	= settings.renderSettings.width  ? settings.renderSettings.width  : settings.videoSettings.width;
+		uint32_t height = settings.renderSettings.height ? settings.renderSettings.height : settings.videoSettings.height;
+		pathsInFlight = std::max<uint32_t>(1, std::min(settings.renderSettings.pathsInFlight, width * height * std::max<uint32_t>(1, settings.renderSettings.samplesPerPixel)));
+		samplesPerPixel = std::max<uint32_t>(1, std::min(settings.renderSettings.samplesPerPixel, pathsInFlight));
+		pathRegeneration = settings.renderSettings.pathRegeneration;
+		fusedTraversal = settings.renderSettings.fusedTraversal;
+		renderMode = settings.renderSettings.renderMode;
+		adaptiveSampling = settings.renderSettings.adaptiveSampling;
+		out_offset = pathsInFlight;
+
+		LOG_INFO("Render resolution: ", width, "x", height, ", ", samplesPerPixel, " spp per update, paths in flight: ", pathsInFlight, 
+				 " (", (width * height * samplesPerPixel + pathsInFlight - 1) / pathsInFlight, " tile(s) per update)\n");
+
 		// === Program shaders ===
-		generateKernel.ComputeShaderProgram("src/shaders/generate.glsl");
-		extendKernel.ComputeShaderProgram("src/shaders/extend.glsl");
-		shadeKernel.ComputeShaderProgram("src/shaders/shade.glsl");
-		connectKernel.ComputeShaderProgram("src/shaders/connect.glsl");
-		imageKernel.ComputeShaderProgram("src/shaders/image.glsl");
-		outputKernel.PixelShaderProgram("src/shaders/output.glsl");
+		// Kernels that trace or shade are compiled per scene in LoadScene
+		kernelDefines = "#define PATHS_IN_FLIGHT " + std::to_string(pathsInFlight) + "\n";
+		kernelDefines += "#define MAX_DEPTH " + std::to_string(MAX_BOUNCES) + "\n";
+		if (settings.renderSettings.stacklessTraversal)
+			kernelDefines += "#define STACKLESS_TRAVERSAL\n";
+		rayStats = settings.profilerSettings.rayStats;
+		if (rayStats)
+			kernelDefines += "#extension GL_KHR_shader_subgroup_arithmetic : enable\n#define RAY_STATS\n";
+		lightBVH = settings.renderSettings.lightBVH;
+		generateKernel.ComputeShaderProgram("src/shaders/generate.glsl", kernelDefines);
+		imageKernel.ComputeShaderProgram("src/shaders/image.glsl", kernelDefines);
+		adaptiveKernel.ComputeShaderProgram("src/shaders/adaptive.glsl", kernelDefines);
+		// Headless renders never present
+		headless = settings.headlessSettings.enabled;
+		if (!headless)
+			outputKernel.PixelShaderProgram("src/shaders/output.glsl");
 
 		// === Render target textures ===
-		outputVAO.Init();
-		outputImg.Init(settings.videoSettings.width, settings.videoSettings.height);
-		outputImg.LoadData(GL_RGBA32F, GL_RGBA, GL_FLOAT, nullptr);
-		outputImg.BindTextureUnit(GL_RGBA32F, GL_WRITE_ONLY, OUTPUT_TEX_BINDING);
-		accumulatorImg.Init(settings.videoSettings.width, settings.videoSettings.height);
+		if (!headless)
+			outputVAO.Init();
+		accumulatorImg.SetName("accumulator", "Accumulation");
+		accumulatorImg.Init(width, height);
 		accumulatorImg.LoadData(GL_RGBA32F, GL_RGBA, GL_FLOAT, nullptr);
-		accumulatorImg.BindTextureUnit(GL_RGBA32F, GL_WRITE_ONLY, ACCUMULATOR_TEX_BINDING);
+		accumulatorImg.BindTextureUnit(GL_RGBA32F, GL_READ_WRITE, ACCUMULATOR_TEX_BINDING);
+		momentsImg.SetName("moments", "Accumulation");
+		momentsImg.Init(width, height);
+		momentsImg.LoadData(GL_R32F, GL_RED, GL_FLOAT, nullptr);
+		momentsImg.BindTextureUnit(GL_R32F, GL_READ_WRITE, MOMENTS_TEX_BINDING);
 
 		// === Buffers ===
-		uniformBuffer.InitBuffer(GL_UNIFORM_BUFFER, GL_DYNAMIC_DRAW);
-		dispatchBuffer.InitBuffer(GL_DISPATCH_INDIRECT_BUFFER, GL_DYNAMIC_DRAW);
-		atomicBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW);
+		dispatchBuffer.InitBuffer(GL_DISPATCH_INDIRECT_BUFFER, GL_DYNAMIC_DRAW, "indirect dispatch", "Wavefront");
+		atomicBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW, "queue counters", "Wavefront");
 
-		uniform_swap.InitBuffer(GL_UNIFORM_BUFFER, GL_DYNAMIC_DRAW);
-		extend_buffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW);
+		uniform_swap.InitBuffer(GL_UNIFORM_BUFFER, GL_STATIC_DRAW, "queue offsets", "Wavefront");
+		extend_buffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW, "extension queue", "Wavefront");
 
-		shadowBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW);
-		hitBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW);
-		pathBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW);
+		shadowBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW, "shadow queue", "Wavefront");
+		hitBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW, "hit records", "Wavefront");
+		pathBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW, "path states", "Wavefront");
 
-		uniformBuffer.InitData(sizeof(Uniforms), 1, UNIFORM_BUFFER_BINDING_INDEX);
+		uniformRing.Init(GL_UNIFORM_BUFFER, UPLOAD_RING_SEGMENT_SIZE, UPLOAD_RING_SEGMENTS, "uniforms", "Wavefront");
 		dispatchBuffer.InitData(sizeof(uint32_t), 3, DISPATCH_BUFFER_BINDING_INDEX);
 		atomicBuffer.InitData(sizeof(Atomics), 1, ATOMIC_BUFFER_BINDING_INDEX);
 
-		extend_buffer.InitData(sizeof(RayBuffer), MAX_WIDTH * MAX_HEIGHT * 2, 3);
-		uniform_swap.InitData(sizeof(uint32_t), 2, 4);
+		// Work buffers hold one tile of paths, the extend queue is double buffered
+		extend_buffer.InitData(sizeof(RayBuffer), pathsInFlight * 2, 3);
+		GLint uniformAlignment = 1;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+		swapStride = std::max<size_t>(sizeof(uint32_t) * 2, size_t(uniformAlignment));
+		uniform_swap.InitData(swapStride, 2);
+		uniform_swap.Bind();
+		uniform_swap.LoadData(in_offset, 0);
+		uniform_swap.LoadData(out_offset, 4);
+		uniform_swap.LoadData(out_offset, size_t(swapStride));
+		uniform_swap.LoadData(in_offset, swapStride + 4);
+		uniform_swap.Unbind();
+		uniform_swap.BindRange(4, 0, sizeof(uint32_t) * 2);
 		
 		// TODO: Refactor
-		shadowBuffer.InitData(sizeof(RayBuffer), MAX_WIDTH * MAX_HEIGHT, SHADOW_BUFFER_BINDING_INDEX);
-		hitBuffer.InitData(76, MAX_WIDTH * MAX_HEIGHT, HIT_BUFFER_BINDING_INDEX);
-		pathBuffer.InitData(84, MAX_WIDTH * MAX_HEIGHT, PATH_BUFFER_BINDING_INDEX);
+		shadowBuffer.InitData(sizeof(RayBuffer), uint32_t(pathsInFlight), SHADOW_BUFFER_BINDING_INDEX);
+		hitBuffer.InitData(sizeof(Hit), uint32_t(pathsInFlight), HIT_BUFFER_BINDING_INDEX);
+		pathBuffer.InitData(GetPathBufferSize(pathsInFlight), 1, PATH_BUFFER_BINDING_INDEX);
+
+		// Regenerated paths splat their radiance, squared luminance and sample count into a per pixel buffer
+		if (pathRegeneration)
+		{
+			splatBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW, "splats", "Accumulation");
+			splatBuffer.InitData(sizeof(uint32_t) * 5, width * height, SPLAT_BUFFER_BINDING_INDEX);
+			splatBuffer.ClearData();
+		}
+
+		// Active pixel list, a count followed by one pixel index per entry
+		activeBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW, "active pixels", "Accumulation");
+		activeBuffer.InitData(sizeof(uint32_t), width * height + 1, ACTIVE_BUFFER_BINDING_INDEX);
+		activePixels = width * height;
+
+		for (uint32_t i = 0; i < READBACK_RING_SIZE; ++i)
+		{
+			activeReadback[i].InitBuffer(GL_COPY_WRITE_BUFFER, GL_STREAM_READ, "active pixel readback", "Accumulation");
+			activeReadback[i].InitData(sizeof(uint32_t), 1);
+		}
+
+		// The kernels always declare the statistics block, it stays small and untouched without RAY_STATS
+		statsBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW, "ray statistics", "Profiling");
+		statsBuffer.InitData(sizeof(RayStats), 1, STATS_BUFFER_BINDING_INDEX);
+		statsBuffer.ClearData();
+		if (rayStats)
+		{
+			for (uint32_t i = 0; i < READBACK_RING_SIZE; ++i)
+			{
+				statsReadback[i].InitBuffer(GL_COPY_WRITE_BUFFER, GL_STREAM_READ, "ray statistics readback", "Profiling");
+				statsReadback[i].InitData(sizeof(RayStats), 1);
+			}
+			glGenQueries(READBACK_RING_SIZE * 2, &statsQueries[0][0]);
+			statsReport.startTime = glfwGetTime();
+		}
+
+		SetUniform(samplesPerPixel, offsetof(Uniforms, samplesPerPixel));
+
+		generateKernel.Use();
+		generateKernel.SetUniformBool("u_regenerate", pathRegeneration);
+		imageKernel.Use();
+		imageKernel.SetUniformBool("u_regenerate", pathRegeneration);
+		adaptiveKernel.Use();
+		adaptiveKernel.SetUniformBool("u_adaptive", adaptiveSampling);
+		adaptiveKernel.SetUniformUInt("u_minSamples", std::max<uint32_t>(2, settings.renderSettings.adaptiveMinSamples));
+		adaptiveKernel.SetUniformFloat("u_threshold", settings.renderSettings.adaptiveThreshold);
+
+		// Up to a frame's worth of batches is timed while the previous frames' results are still pending,
+		// with fewer slots the scheduler would steer on a stale batch time
+		const uint32_t timerRingSize = std::max<uint32_t>(1, settings.schedulerSettings.maxBatchesPerFrame) * (GPU_QUERY_LATENCY_FRAMES + 1);
+		batchTimer.Init(timerRingSize);
+		modeTimers[0].Init(timerRingSize);
+		modeTimers[1].Init(timerRingSize);
+
+		// Stages are timed when the settings ask for it, for the shadow benchmark which is read from the stage
+		// timings, and while the overlay shows them
+		shadowBenchmark = settings.profilerSettings.shadowBenchmark;
+		if (shadowBenchmark && (fusedTraversal || renderMode != RenderMode::Wavefront))
+			LOG_WARNING("The shadow benchmark only times the connect kernel of the unfused wavefront pipeline.\n");
+		stageProfilingRequested = settings.profilerSettings.gpuStages || shadowBenchmark;
+		profilerOverlay = settings.profilerSettings.overlay;
+		profileStages = stageProfilingRequested || profilerOverlay;
+		profilerOutput = settings.profilerSettings.outputPath;
+		if (profileStages)
+			stageProfiler.Init();
+
+		frameCapture.Init(settings.captureSettings);
+		autosaveInterval = settings.captureSettings.autosaveInterval;
+		lastAutosave = glfwGetTime();
 
 		SetEventCallback(EventType::ResetAccumulator, Renderer::OnEvent);
+		SetEventCallback(EventType::SwitchRenderMode, Renderer::OnEvent);
+		SetEventCallback(EventType::ToggleProfilerOverlay, Renderer::OnEvent);
+		SetEventCallback(EventType::LogMemoryUsage, Renderer::OnEvent);
+		SetEventCallback(EventType::SaveImage, Renderer::OnEvent);
 
-		LoadScene("resources/scenes/default.scene");
+		LoadScene(settings.renderSettings.scenePath);
 	}
 
-	void Update()
+	void BeginFrame()
 	{
+		PROFILE_FUNCTION();
 		ResetAccumulator();
-		ResetWorkBuffers();
 		SetDynamicUniforms();
 
-		atomicBuffer.Bind();
-		dispatchBuffer.Bind();
-		outputImg.Bind();
+		if (profileStages)
+			stageProfiler.Collect();
+		if (rayStats)
+			ReadRayStats();
+		frameCapture.Collect();
 
-		generateKernel.Use();
-		generateKernel.Dispatch(GetNumWorkGroups(outputImg.GetWidth() * outputImg.GetHeight()), 1, 1);
-		generateKernel.Barrier(GL_SHADER_STORAGE_BARRIER_BIT);
-		glCopyBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_DISPATCH_INDIRECT_BUFFER, offsetof(Atomics, extendWorkGroup), 0, sizeof(uint32_t));
+		samplesSinceAutosave += samplesThisFrame;
+		if (autosaveInterval > 0.0)
+			UpdateAutosave();
+
+		// Only the first batch of a frame may discard the accumulated samples, the very first batch always does
+		resetThisFrame = accProfiler.reset || frame == 0;
+		batchesThisFrame = 0;
+		samplesThisFrame = 0;
+	}
+
+	void Render()
+	{
+		PROFILE_FUNCTION();
+		const bool reset = resetThisFrame && batchesThisFrame == 0;
+
+		// A reset brings every pixel back, counts read back from before it no longer apply
+		if (reset)
+		{
+			++epoch;
+			activePixels = accumulatorImg.GetWidth() * accumulatorImg.GetHeight();
+		}
+		ReadActivePixels();
+
+		// A converged image draws no samples, so the sequence and frame index stay where they are
+		if (IsConverged())
+			return;
+
+		// Sampler indices restart with the accumulation so each pixel walks one sequence from its start
+		if (reset)
+			sampleBase = 0;
+
+		SetUniform(++frame, offsetof(Uniforms, frame));
+		SetUniform(sampleBase, offsetof(Uniforms, sampleBase));
+		UploadUniforms();
+		sampleBase += samplesPerPixel;
+
+		// Megakernel paths are resolved from the path buffer like tiled wavefront paths
+		batchMode = SelectRenderMode();
+		const bool megakernel = batchMode == RenderMode::Megakernel;
+		referenceOcclusion = shadowBenchmark && (shadowBenchmarkBatch++ & 1) != 0;
+
+		imageKernel.Use();
+		imageKernel.SetUniformBool("u_resetAccumulator", reset);
+		imageKernel.SetUniformBool("u_regenerate", pathRegeneration && !megakernel);
+
+		batchTimer.Start();
+		modeTimers[megakernel].Start();
+		if (rayStats)
+			StartRayStats();
+
+		MarkActivePixels(reset);
+
+		// Stream the batch's samples through the work buffers one tile of active pixels at a time,
+		// tiles past the actual end of the list exit early on the GPU
+		const uint32_t pixelsPerTile = pathsInFlight / samplesPerPixel;
+		if (megakernel)
+			for (uint32_t tileOffset = 0; tileOffset < activePixels; tileOffset += pixelsPerTile)
+				RenderTileMegakernel(tileOffset, std::min(pixelsPerTile, activePixels - tileOffset) * samplesPerPixel);
+		else if (pathRegeneration)
+			RenderRegenerated(activePixels * samplesPerPixel);
+		else
+			for (uint32_t tileOffset = 0; tileOffset < activePixels; tileOffset += pixelsPerTile)
+				RenderTile(tileOffset, std::min(pixelsPerTile, activePixels - tileOffset) * samplesPerPixel);
+
+		modeTimers[megakernel].Stop();
+		batchTimer.Stop();
+		++batchesThisFrame;
+		samplesThisFrame += uint64_t(activePixels) * samplesPerPixel;
+
+		if (rayStats)
+			CopyRayStats();
+	}
+
+	void Present()
+	{
+		PROFILE_FUNCTION();
+		// The accumulator was written through image stores, make them visible to texture fetches
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+		accumulatorImg.ActiveTexture(0);
+		accumulatorImg.Bind();
+		outputKernel.Use();
+		BeginStage("output");
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+		EndStage();
+		accumulatorImg.Unbind();
+	}
+
+	void Shutdown()
+	{
+		// Captures still in flight are written out before the GL objects go away
+		frameCapture.Flush();
+
+		if (profileStages)
+		{
+			// Wait for the last queries so the dump covers every timed dispatch
+			glFinish();
+			stageProfiler.Collect();
+
+			std::error_code error;
+			std::filesystem::create_directories(profilerOutput, error);
+			stageProfiler.WriteCSV(profilerOutput + "gpu_stages.csv");
+			stageProfiler.WriteJSON(profilerOutput + "gpu_stages.json");
+			LOG_INFO("GPU stage timings written to ", profilerOutput, "\n");
+
+			if (shadowBenchmark)
+				LogShadowBenchmark();
+		}
+
+		if (rayStats)
+			glDeleteQueries(READBACK_RING_SIZE * 2, &statsQueries[0][0]);
+
+		delete scene;
+
+		for (auto& variant : kernelVariants)
+			delete variant.second;
+		kernelVariants.clear();
+	}
+
+	uint32_t GetSamplesPerPixel()
+	{
+		return samplesPerPixel;
+	}
+
+	uint64_t GetFrameSamples()
+	{
+		return samplesThisFrame;
+	}
+
+	double GetBatchTime()
+	{
+		return batchTimer.GetLast();
+	}
+
+	bool IsConverged()
+	{
+		// A pending reset brings every pixel back on the next batch
+		return adaptiveSampling && activePixels == 0 && !accProfiler.reset;
+	}
+
+	std::string GetProfilerOverlay()
+	{
+		if (!profilerOverlay)
+			return std::string();
+
+		return (profileStages ? stageProfiler.GetOverlay() : std::string()) + rayStatsOverlay;
+	}
+
+	void SaveImage(const std::string& name)
+	{
+		if (!frameCapture.Request(accumulatorImg, name))
+			LOG_WARNING("Every capture slot is in flight, ", name, " was not saved.\n");
+	}
+
+	namespace
+	{
+		void MarkActivePixels(const bool& reset)
+		{
+			PROFILE_FUNCTION();
+			const uint32_t nPixels = accumulatorImg.GetWidth() * accumulatorImg.GetHeight();
+
+			activeBuffer.Bind();
+			activeBuffer.ClearData(0, 0, sizeof(uint32_t));
+			activeBuffer.Unbind();
+
+			adaptiveKernel.Use();
+			adaptiveKernel.SetUniformBool("u_resetAccumulator", reset);
+			BeginStage("adaptive");
+			adaptiveKernel.Dispatch(GetNumWorkGroups(nPixels), 1, 1);
+			EndStage();
+			adaptiveKernel.Barrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+			// Skip the readback when every slot is still in flight
+			if (readbackHead - readbackTail == READBACK_RING_SIZE)
+				return;
+
+			uint32_t slot = readbackHead % READBACK_RING_SIZE;
+			activeBuffer.Bind();
+			activeReadback[slot].Bind();
+			glCopyBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(uint32_t));
+			activeReadback[slot].Unbind();
+			activeBuffer.Unbind();
+
+			activeFence[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			activeEpoch[slot] = epoch;
+			++readbackHead;
+		}
+
+		void ReadActivePixels()
+		{
+			PROFILE_FUNCTION();
+			while (readbackTail != readbackHead)
+			{
+				uint32_t slot = readbackTail % READBACK_RING_SIZE;
+				GLenum status = glClientWaitSync(activeFence[slot], 0, 0);
+				if (status == GL_TIMEOUT_EXPIRED)
+					break;
+
+				glDeleteSync(activeFence[slot]);
+				++readbackTail;
+
+				if (activeEpoch[slot] != epoch)
+					continue;
+
+				uint32_t count = 0;
+				activeReadback[slot].Bind();
+				activeReadback[slot].GetData(0, sizeof(uint32_t), &count);
+				activeReadback[slot].Unbind();
+
+				if (adaptiveSampling && count == 0 && activePixels != 0)
+					LOG_INFO("Every pixel converged, sampling stopped.\n");
+
+				activePixels = count;
+			}
+		}
+
+		void StartRayStats()
+		{
+			// The slot can't be freed before the batch ends, ReadRayStats only runs between frames
+			if (statsHead - statsTail < READBACK_RING_SIZE)
+				glQueryCounter(statsQueries[statsHead % READBACK_RING_SIZE][0], GL_TIMESTAMP);
+		}
+
+		void CopyRayStats()
+		{
+			PROFILE_FUNCTION();
+
+			// A batch whose slot is still in flight goes unreported, its counters are dropped
+			if (statsHead - statsTail < READBACK_RING_SIZE)
+			{
+				uint32_t slot = statsHead % READBACK_RING_SIZE;
+				glQueryCounter(statsQueries[slot][1], GL_TIMESTAMP);
+				statsBuffer.Bind();
+				statsReadback[slot].Bind();
+				glCopyBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(RayStats));
+				statsReadback[slot].Unbind();
+				statsBuffer.Unbind();
+
+				statsFence[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				++statsHead;
+			}
+
+			statsBuffer.ClearData();
+		}
+
+		void ReadRayStats()
+		{
+			PROFILE_FUNCTION();
+
+			while (statsTail != statsHead)
+			{
+				uint32_t slot = statsTail % READBACK_RING_SIZE;
+				if (glClientWaitSync(statsFence[slot], 0, 0) == GL_TIMEOUT_EXPIRED)
+					break;
+
+				glDeleteSync(statsFence[slot]);
+				++statsTail;
+
+				RayStats stats;
+				statsReadback[slot].Bind();
+				statsReadback[slot].GetData(0, sizeof(RayStats), &stats);
+				statsReadback[slot].Unbind();
+
+				statsReport.extendRays += stats.extendRays;
+				statsReport.shadowRays += stats.shadowRays;
+				statsReport.nodesVisited += stats.nodesVisited;
+				statsReport.primitivesTested += stats.primitivesTested;
+				for (uint32_t i = 0; i <= MAX_BOUNCES; ++i)
+					statsReport.activePaths[i] += stats.activePaths[i];
+
+				// Both timestamps were written before the fence, reading them doesn't wait
+				GLuint64 start = 0, end = 0;
+				glGetQueryObjectui64v(statsQueries[slot][0], GL_QUERY_RESULT, &start);
+				glGetQueryObjectui64v(statsQueries[slot][1], GL_QUERY_RESULT, &end);
+				statsReport.gpuTime += double(end - start) * 1e-6;
+				++statsReport.batches;
+			}
+
+			if (glfwGetTime() - statsReport.startTime >= RAY_STATS_INTERVAL)
+				ReportRayStats();
+		}
+
+		void ReportRayStats()
+		{
+			const double rays = double(statsReport.extendRays + statsReport.shadowRays);
+			if (statsReport.batches > 0 && rays > 0.0)
+			{
+				const double mrays = statsReport.gpuTime > 0.0 ? rays / (statsReport.gpuTime * 1000.0) : 0.0;
+
+				std::ostringstream report;
+				report.precision(1);
+				report << std::fixed << mrays << " Mrays/s, " << double(statsReport.nodesVisited) / rays << " nodes and "
+					   << double(statsReport.primitivesTested) / rays << " primitives per ray, paths per bounce:";
+				for (uint32_t i = 0; i <= MAX_BOUNCES && statsReport.activePaths[0] > 0; ++i)
+					report << " " << 100.0 * double(statsReport.activePaths[i]) / double(statsReport.activePaths[0]) << "%";
+
+				LOG_INFO("Ray statistics over ", statsReport.batches, " batches: ", report.str(), "\n");
 
-		atomicBuffer.Unbind();
+				std::ostringstream overlay;
+				overlay.precision(1);
+				overlay << std::fixed << " | " << mrays << " Mrays/s " << double(statsReport.nodesVisited) / rays << " nodes/ray";
+				rayStatsOverlay = overlay.str();
+			}
+
+			statsReport = RayStatsReport();
+			statsReport.startTime = glfwGetTime();
+		}
 
-		for (uint32_t i = 0; i < MAX_BOUNCES; ++i)
+		void RenderTile(const uint32_t& tileOffset, const uint32_t& tileSize)
 		{
+			PROFILE_FUNCTION();
+			ResetWorkBuffers();
+			SetTileUniforms(tileOffset, tileSize);
+
 			atomicBuffer.Bind();
+			dispatchBuffer.Bind();
+
+			generateKernel.Use();
+			BeginStage("generate");
+			generateKernel.Dispatch(GetNumWorkGroups(tileSize), 1, 1);
+			EndStage();
+			generateKernel.Barrier(GL_SHADER_STORAGE_BARRIER_BIT);
+			glCopyBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_DISPATCH_INDIRECT_BUFFER, fusedTraversal ? offsetof(Atomics, traceWorkGroup) : offsetof(Atomics, extendWorkGroup), 0, sizeof(uint32_t));
+
+			atomicBuffer.Unbind();
+
+			// Vertices 0 to MAX_BOUNCES are shaded, as in the megakernel and in regeneration. The last shade adds the
+			// previous vertex's connected light sample and the emission the path hit, then terminates every path.
+			for (uint32_t i = 0; i <= MAX_BOUNCES; ++i)
+				fusedTraversal ? TraceBounceFused(i) : TraceBounce(i);
+
+			imageKernel.Use();
+			BeginStage("image");
+			imageKernel.Dispatch(GetNumWorkGroups(tileSize / samplesPerPixel), 1, 1);
+			EndStage();
+			imageKernel.Barrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+			dispatchBuffer.Unbind();
+		}
+
+		void RenderTileMegakernel(const uint32_t& tileOffset, const uint32_t& tileSize)
+		{
+			PROFILE_FUNCTION();
+			SetTileUniforms(tileOffset, tileSize);
+
+			kernels->megakernel.Use();
+			BeginStage("megakernel");
+			kernels->megakernel.Dispatch(GetNumWorkGroups(tileSize), 1, 1);
+			EndStage();
+			kernels->megakernel.Barrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+			imageKernel.Use();
+			BeginStage("image");
+			imageKernel.Dispatch(GetNumWorkGroups(tileSize / samplesPerPixel), 1, 1);
+			EndStage();
+			imageKernel.Barrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		}
 
-			extendKernel.Use();
+		RenderMode SelectRenderMode()
+		{
+			if (renderMode != RenderMode::Benchmark)
+				return renderMode;
+
+			if (benchmarkBatch < BENCHMARK_BATCHES * 2)
+				return benchmarkBatch++ < BENCHMARK_BATCHES ? RenderMode::Wavefront : RenderMode::Megakernel;
+
+			// Timings arrive a few batches late, keep alternating until both pipelines have a benchmark's worth.
+			// Each is judged by its mean over every batch read back so one noisy batch doesn't decide the run.
+			if (modeTimers[0].GetCount() < BENCHMARK_BATCHES || modeTimers[1].GetCount() < BENCHMARK_BATCHES)
+				return batchMode == RenderMode::Wavefront ? RenderMode::Megakernel : RenderMode::Wavefront;
+
+			double wavefrontTime = modeTimers[0].GetMean();
+			double megakernelTime = modeTimers[1].GetMean();
+
+			renderMode = megakernelTime < wavefrontTime ? RenderMode::Megakernel : RenderMode::Wavefront;
+			LOG_INFO("Benchmark: wavefront ", wavefrontTime, " ms, megakernel ", megakernelTime, " ms per batch, using the ",
+					 renderMode == RenderMode::Megakernel ? "megakernel" : "wavefront pipeline", ".\n");
+			return renderMode;
+		}
+
+		void TraceBounce(const uint32_t& bounce)
+		{
+			PROFILE_FUNCTION();
+			atomicBuffer.Bind();
+
+			kernels->extend.Use();
+			BeginStage("extend", bounce);
 			glDispatchComputeIndirect(NULL);
-			extendKernel.Barrier(GL_SHADER_STORAGE_BARRIER_BIT);
+			EndStage();
+			kernels->extend.Barrier(GL_SHADER_STORAGE_BARRIER_BIT);
 			glCopyBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_DISPATCH_INDIRECT_BUFFER, offsetof(Atomics, shadeWorkGroup), 0, sizeof(uint32_t));
-			atomicBuffer.LoadData(1, offsetof(Atomics, extendWorkGroup)); 
-			atomicBuffer.LoadData(0, offsetof(Atomics, extendThreadCounter));
+			atomicBuffer.ClearData(1, offsetof(Atomics, extendWorkGroup), sizeof(uint32_t));
+			atomicBuffer.ClearData(0, offsetof(Atomics, extendThreadCounter), sizeof(uint32_t));
 
-			shadeKernel.Use();
-			shadeKernel.SetUniformUInt("u_depth", i);
+			kernels->shade.Use();
+			BeginStage("shade", bounce);
 			glDispatchComputeIndirect(NULL);
-			shadeKernel.Barrier(GL_SHADER_STORAGE_BARRIER_BIT);
+			EndStage();
+			kernels->shade.Barrier(GL_SHADER_STORAGE_BARRIER_BIT);
 			glCopyBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_DISPATCH_INDIRECT_BUFFER, offsetof(Atomics, connectWorkGroup), 0, sizeof(uint32_t));
-			atomicBuffer.LoadData(1, offsetof(Atomics, shadeWorkGroup));
-			atomicBuffer.LoadData(0, offsetof(Atomics, shadeThreadCounter));
+			atomicBuffer.ClearData(1, offsetof(Atomics, shadeWorkGroup), sizeof(uint32_t));
+			atomicBuffer.ClearData(0, offsetof(Atomics, shadeThreadCounter), sizeof(uint32_t));
 
-			connectKernel.Use();
+			ComputeShader& connect = referenceOcclusion ? kernels->connectReference : kernels->connect;
+			connect.Use();
+			BeginStage(referenceOcclusion ? "connect-reference" : "connect", bounce);
 			glDispatchComputeIndirect(NULL);
-			connectKernel.Barrier(GL_SHADER_STORAGE_BARRIER_BIT);
+			EndStage();
+			connect.Barrier(GL_SHADER_STORAGE_BARRIER_BIT);
 			glCopyBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_DISPATCH_INDIRECT_BUFFER, offsetof(Atomics, extendWorkGroup), 0, sizeof(uint32_t));
-			atomicBuffer.LoadData(1, offsetof(Atomics, connectWorkGroup));
-			atomicBuffer.LoadData(0, offsetof(Atomics, connectThreadCounter));
+			atomicBuffer.ClearData(1, offsetof(Atomics, connectWorkGroup), sizeof(uint32_t));
+			atomicBuffer.ClearData(0, offsetof(Atomics, connectThreadCounter), sizeof(uint32_t));
 
 			atomicBuffer.Unbind();
 			SwapBuffers();
 		}
 
-		imageKernel.Use();
-		imageKernel.Dispatch(GetNumWorkGroups(outputImg.GetWidth() * outputImg.GetHeight()), 1, 1);
-		imageKernel.Barrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		// One traversal dispatch per bounce, the trace kernel connects the shadow rays the previous shade
+		// enqueued while it extends the paths. The last shade enqueues none, every path ends at MAX_DEPTH.
+		void TraceBounceFused(const uint32_t& bounce)
+		{
+			PROFILE_FUNCTION();
+			atomicBuffer.Bind();
 
-		outputKernel.Use();
-		glDrawArrays(GL_TRIANGLES, 0, 6);
+			kernels->trace.Use();
+			BeginStage("trace", bounce);
+			glDispatchComputeIndirect(NULL);
+			EndStage();
+			kernels->trace.Barrier(GL_SHADER_STORAGE_BARRIER_BIT);
+			glCopyBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_DISPATCH_INDIRECT_BUFFER, offsetof(Atomics, shadeWorkGroup), 0, sizeof(uint32_t));
+			atomicBuffer.ClearData(1, offsetof(Atomics, extendWorkGroup), sizeof(uint32_t));
+			atomicBuffer.ClearData(0, offsetof(Atomics, extendThreadCounter), sizeof(uint32_t));
+			atomicBuffer.ClearData(1, offsetof(Atomics, connectWorkGroup), sizeof(uint32_t));
+			atomicBuffer.ClearData(0, offsetof(Atomics, connectThreadCounter), sizeof(uint32_t));
+			atomicBuffer.ClearData(1, offsetof(Atomics, traceWorkGroup), sizeof(uint32_t));
 
-		dispatchBuffer.Unbind();
-		outputImg.Unbind();
-	}
+			kernels->shade.Use();
+			BeginStage("shade", bounce);
+			glDispatchComputeIndirect(NULL);
+			EndStage();
+			kernels->shade.Barrier(GL_SHADER_STORAGE_BARRIER_BIT);
+			glCopyBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_DISPATCH_INDIRECT_BUFFER, offsetof(Atomics, traceWorkGroup), 0, sizeof(uint32_t));
+			atomicBuffer.ClearData(1, offsetof(Atomics, shadeWorkGroup), sizeof(uint32_t));
+			atomicBuffer.ClearData(0, offsetof(Atomics, shadeThreadCounter), sizeof(uint32_t));
 
-	void Shutdown()
-	{
-		delete scene;
-	}
+			atomicBuffer.Unbind();
+			SwapBuffers();
+		}
+
+		void RenderRegenerated(const uint32_t& nSamples)
+		{
+			PROFILE_FUNCTION();
+			const uint32_t nPixels = nSamples / samplesPerPixel;
+			const uint32_t nPaths = std::min(pathsInFlight, nSamples);
+
+			ResetWorkBuffers();
+			SetTileUniforms(0, nPaths);
+
+			atomicBuffer.Bind();
+			dispatchBuffer.Bind();
+
+			// Fill every slot once, the shade kernel refills them from the pending samples as paths finish
+			generateKernel.Use();
+			BeginStage("generate");
+			generateKernel.Dispatch(GetNumWorkGroups(nPaths), 1, 1);
+			EndStage();
+			generateKernel.Barrier(GL_SHADER_STORAGE_BARRIER_BIT);
+			glCopyBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_DISPATCH_INDIRECT_BUFFER, fusedTraversal ? offsetof(Atomics, traceWorkGroup) : offsetof(Atomics, extendWorkGroup), 0, sizeof(uint32_t));
+
+			atomicBuffer.Unbind();
+
+			// While samples are pending every slot is busy and a path lives at most MAX_BOUNCES + 1 iterations,
+			// so this bound drains the pool without reading the counters back. Drained iterations launch one empty group.
+			const uint32_t nWaves = (nSamples + pathsInFlight - 1) / pathsInFlight + 1;
+			// Iterations past the first MAX_BOUNCES mix path depths, their stages share the last index
+			for (uint32_t i = 0; i < (MAX_BOUNCES + 1) * nWaves; ++i)
+				fusedTraversal ? TraceBounceFused(std::min<uint32_t>(i, MAX_BOUNCES)) : TraceBounce(std::min<uint32_t>(i, MAX_BOUNCES));
+
+			// Resolve the splats of every active pixel
+			SetTileUniforms(0, nSamples);
+			imageKernel.Use();
+			BeginStage("image");
+			imageKernel.Dispatch(GetNumWorkGroups(nPixels), 1, 1);
+			EndStage();
+			imageKernel.Barrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+			dispatchBuffer.Unbind();
+		}
 
-	namespace
-	{
 		void SetDynamicUniforms()
 		{
-			uniformBuffer.Bind();
-			uniformBuffer.LoadData(scene->camera->GetView(), offsetof(Uniforms, camView));
-			uniformBuffer.LoadData(scene->camera->GetWorldPosition(), offsetof(Uniforms, camWorldPos));
-			uniformBuffer.LoadData(scene->camera->GetFieldOfView(), offsetof(Uniforms, FOV));
-			uniformBuffer.LoadData(++frame, offsetof(Uniforms, frame));
-			uniformBuffer.Unbind();
+			PROFILE_FUNCTION();
+			SetUniform(scene->camera->GetView(), offsetof(Uniforms, camView));
+			SetUniform(scene->camera->GetWorldPosition(), offsetof(Uniforms, camWorldPos));
+			SetUniform(scene->camera->GetFieldOfView(), offsetof(Uniforms, FOV));
+		}
+
+		void SetTileUniforms(const uint32_t& tileOffset, const uint32_t& tileSize)
+		{
+			PROFILE_FUNCTION();
+			SetUniform(tileOffset, offsetof(Uniforms, tileOffset));
+			SetUniform(tileSize, offsetof(Uniforms, tileSize));
+			UploadUniforms();
+		}
+
+		template<typename T>
+		void SetUniform(const T& value, const size_t& offset)
+		{
+			std::memcpy(uniformData + offset, &value, sizeof(value));
+		}
+
+		void UploadUniforms()
+		{
+			uniformRing.Upload(uniformData, UNIFORM_BUFFER_BINDING_INDEX);
 		}
 
 		void ResetWorkBuffers()
 		{
+			PROFILE_FUNCTION();
 			atomicBuffer.Bind();
 			dispatchBuffer.Bind();
 
-			// TODO: create this wrapper
-			uint32_t ones[3]{ 1, 1, 1 };
-			glBufferSubData(GL_DISPATCH_INDIRECT_BUFFER, 0, sizeof(uint32_t) * 3, &ones[0]);
-			glBufferSubData(GL_SHADER_STORAGE_BUFFER,	 0, sizeof(uint32_t) * 3, &ones[0]);
-			glBufferSubData(GL_SHADER_STORAGE_BUFFER,	12, sizeof(uint32_t) * 3, (void*)0);
+			// One work group per queue, empty queues and no samples taken
+			dispatchBuffer.ClearData(1, 0, sizeof(uint32_t) * 3);
+			atomicBuffer.ClearData(1, offsetof(Atomics, extendWorkGroup), sizeof(uint32_t) * 3);
+			atomicBuffer.ClearData(0, offsetof(Atomics, extendThreadCounter), sizeof(uint32_t) * 4);
+			atomicBuffer.ClearData(1, offsetof(Atomics, traceWorkGroup), sizeof(uint32_t));
 
 			atomicBuffer.Unbind();
 			dispatchBuffer.Unbind();
@@ -188,21 +820,71 @@ namespace PT::Renderer
 				{
 					accProfiler.reset = false;
 					accProfiler.totalTime = 0.0;
-					imageKernel.Use();
-					imageKernel.SetUniformBool("u_resetAccumulator", false);
 				}
 
 				accProfiler.resetTimer = false;
 			}
 		}
 
+		void UpdateAutosave()
+		{
+			// Autosaves wait for the previous one to be written and skip renders that have not progressed
+			const double time = glfwGetTime();
+			if (time - lastAutosave < autosaveInterval || samplesSinceAutosave == 0 || frameCapture.IsBusy())
+				return;
+
+			SaveImage("autosave");
+			lastAutosave = time;
+			samplesSinceAutosave = 0;
+		}
+
+		void BeginStage(const char* kind, const uint32_t& index)
+		{
+			if (profileStages)
+				stageProfiler.Begin(std::string(kind) + "/" + std::to_string(index));
+		}
+
+		void BeginStage(const char* kind)
+		{
+			if (profileStages)
+				stageProfiler.Begin(kind);
+		}
+
+		void EndStage()
+		{
+			if (profileStages)
+				stageProfiler.End();
+		}
+
+		// Both connect kernels trace the same shadow rays, so their average times summed over the bounces compare
+		// the two occlusion traversals directly
+		void LogShadowBenchmark()
+		{
+			double connectTime = 0.0, referenceTime = 0.0;
+			for (const StageStats& stage : stageProfiler.GetStats())
+			{
+				std::string kind = stage.name.substr(0, stage.name.find('/'));
+				if (kind == "connect")
+					connectTime += stage.avg;
+				else if (kind == "connect-reference")
+					referenceTime += stage.avg;
+			}
+
+			if (connectTime == 0.0 || referenceTime == 0.0)
+			{
+				LOG_WARNING("The shadow benchmark timed no batch of one of the connect kernels.\n");
+				return;
+			}
+
+			LOG_INFO("Shadow benchmark: connect ", connectTime, " ms, reference occlusion traversal ", referenceTime,
+					 " ms per tile over every bounce (", referenceTime / connectTime, "x).\n");
+		}
+
 		void SwapBuffers()
 		{
+			PROFILE_FUNCTION();
 			std::swap(in_offset, out_offset);
-			uniform_swap.Bind();
-			uniform_swap.LoadData(in_offset, 0);
-			uniform_swap.LoadData(out_offset, 4);
-			uniform_swap.Unbind();
+			uniform_swap.BindRange(4, in_offset == 0 ? 0 : swapStride, sizeof(uint32_t) * 2);
 		}
 
 		void OnEvent(Event* e)
@@ -215,8 +897,30 @@ namespace PT::Renderer
 					accProfiler.lastTime = resetEvent->time;
 					accProfiler.reset = true;
 					accProfiler.resetTimer = true;
-					imageKernel.Use();
-					imageKernel.SetUniformBool("u_resetAccumulator", true);
+					break;
+				}
+				case EventType::SwitchRenderMode:
+				{
+					renderMode = batchMode == RenderMode::Wavefront ? RenderMode::Megakernel : RenderMode::Wavefront;
+					LOG_INFO("Render mode: ", renderMode == RenderMode::Megakernel ? "megakernel" : "wavefront", "\n");
+					break;
+				}
+				case EventType::LogMemoryUsage:
+				{
+					GPUMemory::LogBreakdown();
+					break;
+				}
+				case EventType::SaveImage:
+				{
+					SaveImage("render_" + std::to_string(sampleBase) + "spp");
+					break;
+				}
+				case EventType::ToggleProfilerOverlay:
+				{
+					profilerOverlay = !profilerOverlay;
+					if (profilerOverlay && !profileStages)
+						stageProfiler.Init();
+					profileStages = stageProfilingRequested || profilerOverlay;
 					break;
 				}
 				default:
@@ -227,35 +931,55 @@ namespace PT::Renderer
 		// === Load scene data into GPU memory ===
 		void LoadScene(const std::string& filePath)
 		{
+			PROFILE_FUNCTION();
 			scene = new Scene(filePath);
+			PROFILE_SCOPE("Scene upload");
 
 			// Camera
-			scene->camera->SetResolution(outputImg.GetWidth(), outputImg.GetHeight());
+			scene->camera->SetResolution(accumulatorImg.GetWidth(), accumulatorImg.GetHeight());
 		
-			// HDRI texture
-			scene->HDRItexture.BindTextureUnit(GL_RGBA16F, GL_READ_ONLY, SCENE_TEX_BINDING);
-			shadeKernel.Use();
-			shadeKernel.SetUniformInt("u_HDRI", 2);
+			// HDRI texture and its sampling distribution, an empty distribution keeps the buffer valid
+			const EnvironmentMap& environment = scene->HDRItexture;
+			const bool hasEnvironment = !environment.GetDistribution().empty();
+
+			environment.ActiveTexture(SCENE_TEX_BINDING);
+			environment.Bind();
+			environment.ActiveTexture(0);
+			kernels = SelectSceneKernels(scene->GetFeatureMask());
+			for (ComputeShader* kernel : { &kernels->shade, &kernels->megakernel })
+			{
+				kernel->Use();
+				kernel->SetUniformInt("u_HDRI", SCENE_TEX_BINDING);
+				kernel->SetUniformBool("u_environment", hasEnvironment);
+			}
+
+			environmentBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_STATIC_DRAW, "environment distribution", "Scene");
+			environmentBuffer.InitData(sizeof(float), uint32_t(2 + std::max<size_t>(1, environment.GetDistribution().size())), ENVIRONMENT_BUFFER_BINDING_INDEX);
+			if (hasEnvironment)
+			{
+				environmentBuffer.Bind();
+				environmentBuffer.LoadData(environment.GetWidth(), 0);
+				environmentBuffer.LoadData(environment.GetHeight(), sizeof(uint32_t));
+				environmentBuffer.LoadData(environment.GetDistribution().front(), sizeof(uint32_t) * 2, uint32_t(environment.GetDistribution().size()));
+				environmentBuffer.Unbind();
+			}
 
 			// Scene uniforms
-			uniformBuffer.Bind();
-			uniformBuffer.LoadData(scene->camera->GetView(),		  offsetof(Uniforms, camView));
-			uniformBuffer.LoadData(scene->camera->GetWorldPosition(), offsetof(Uniforms, camWorldPos));
-			uniformBuffer.LoadData(scene->camera->GetFieldOfView(),	  offsetof(Uniforms, FOV));
-			uniformBuffer.LoadData(scene->sphereLights.size(),		  offsetof(Uniforms, nSphereLights));
-			uniformBuffer.LoadData(scene->spheres.size(),			  offsetof(Uniforms, nSpheres));
-			uniformBuffer.LoadData(scene->models.size(),			  offsetof(Uniforms, nModels));
-			uniformBuffer.Unbind();
+			SetUniform(scene->camera->GetView(),		  offsetof(Uniforms, camView));
+			SetUniform(scene->camera->GetWorldPosition(), offsetof(Uniforms, camWorldPos));
+			SetUniform(scene->camera->GetFieldOfView(),	  offsetof(Uniforms, FOV));
+			SetUniform(uint32_t(scene->sphereLights.size()), offsetof(Uniforms, nSphereLights));
+			SetUniform(uint32_t(scene->sphereLights.size() + scene->triangleLights.size()), offsetof(Uniforms, nLights));
+			SetUniform(uint32_t(scene->spheres.size()),		 offsetof(Uniforms, nSpheres));
+			SetUniform(uint32_t(scene->models.size()),		 offsetof(Uniforms, nModels));
 
 			// TODO: Improve
-			sceneBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_STATIC_DRAW);
+			sceneBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_STATIC_DRAW, "scene slabs", "Scene");
 			sceneBuffer.InitData(sceneBufferSize, 1, SCENE_BUFFER_BINDING_INDEX);
 
 			size_t offset = 0;
 			sceneBuffer.Bind();
 			sceneBuffer.LoadData(scene->materials.front(),	  size_t(offset), scene->materials.size());	   offset += sizeof(Material) * MAX_MATERIALS;
-			sceneBuffer.LoadData(scene->spheres.front(),	  size_t(offset), scene->spheres.size());	   offset += sizeof(Sphere) * MAX_SPHERES;
-			sceneBuffer.LoadData(scene->sphereLights.front(), size_t(offset), scene->sphereLights.size()); offset += sizeof(SphereLight) * MAX_SPHERE_LIGHTS;
 
 			for (size_t i = 0; i < scene->models.size(); ++i) 
 			{
@@ -263,11 +987,124 @@ namespace PT::Renderer
 				offset += sizeof(GPUTriangle) * MAX_TRIANGLES;
 				sceneBuffer.LoadData(scene->models[i].gpuNodes.front(), size_t(offset), scene->models[i].gpuNodes.size());
 				offset += sizeof(GPUBVHNode) * MAX_NODES;
-				sceneBuffer.LoadData(scene->models[i].matid, size_t(offset), sizeof(uint32_t));
+				sceneBuffer.LoadData(scene->models[i].matid, size_t(offset));
+				sceneBuffer.LoadData(scene->models[i].lightOffset, size_t(offset + sizeof(uint32_t)));
 				offset += sizeof(uint32_t) * 4;
 			}
 
 			sceneBuffer.Unbind();
+
+			// The slabs are sized for MAX_MATERIALS, MAX_TRIANGLES and MAX_NODES whatever the scene holds
+			size_t sceneBytesUsed = sizeof(Material) * scene->materials.size();
+			for (const Model& model : scene->models)
+				sceneBytesUsed += sizeof(GPUTriangle) * model.gpuTriangles.size() + sizeof(GPUBVHNode) * model.gpuNodes.size() + sizeof(uint32_t) * 4;
+			sceneBuffer.SetUsedBytes(sceneBytesUsed);
+
+			// Spheres and sphere lights are traced through their own BVH, see Scene::BuildAnalyticBVH
+			sphereBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_STATIC_DRAW, "spheres", "Scene");
+			analyticNodeBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_STATIC_DRAW, "analytic BVH", "Scene");
+			analyticPrimitiveBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_STATIC_DRAW, "analytic primitives", "Scene");
+			sphereBuffer.InitData(sizeof(Sphere), uint32_t(std::max<size_t>(1, scene->spheres.size())), SPHERE_BUFFER_BINDING_INDEX);
+			analyticNodeBuffer.InitData(sizeof(GPUBVHNode), uint32_t(std::max<size_t>(1, scene->analyticNodes.size())), ANALYTIC_NODE_BUFFER_BINDING_INDEX);
+			analyticPrimitiveBuffer.InitData(sizeof(uint32_t), uint32_t(std::max<size_t>(1, scene->analyticPrimitives.size())), ANALYTIC_PRIMITIVE_BUFFER_BINDING_INDEX);
+
+			if (!scene->spheres.empty())
+			{
+				sphereBuffer.Bind();
+				sphereBuffer.LoadData(scene->spheres.front(), 0, uint32_t(scene->spheres.size()));
+				sphereBuffer.Unbind();
+			}
+			if (!scene->analyticNodes.empty())
+			{
+				analyticNodeBuffer.Bind();
+				analyticNodeBuffer.LoadData(scene->analyticNodes.front(), 0, uint32_t(scene->analyticNodes.size()));
+				analyticNodeBuffer.Unbind();
+				analyticPrimitiveBuffer.Bind();
+				analyticPrimitiveBuffer.LoadData(scene->analyticPrimitives.front(), 0, uint32_t(scene->analyticPrimitives.size()));
+				analyticPrimitiveBuffer.Unbind();
+			}
+
+			// Lights and their sampling structures live in their own buffers so the light count is unbounded
+			LightSampler lightSampler;
+			std::vector<LightBounds> lightBounds;
+			for (const SphereLight& light : scene->sphereLights)
+				lightBounds.emplace_back(GetLightBounds(light));
+			for (const TriangleLight& light : scene->triangleLights)
+				lightBounds.emplace_back(GetLightBounds(light));
+			lightSampler.Build(lightBounds);
+
+			sphereLightBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_STATIC_DRAW, "sphere lights", "Lights");
+			triangleLightBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_STATIC_DRAW, "triangle lights", "Lights");
+			lightNodeBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_STATIC_DRAW, "light BVH", "Lights");
+			lightEntryBuffer.InitBuffer(GL_SHADER_STORAGE_BUFFER, GL_STATIC_DRAW, "light table", "Lights");
+			sphereLightBuffer.InitData(sizeof(SphereLight), uint32_t(std::max<size_t>(1, scene->sphereLights.size())), SPHERE_LIGHT_BUFFER_BINDING_INDEX);
+			triangleLightBuffer.InitData(sizeof(TriangleLight), uint32_t(std::max<size_t>(1, scene->triangleLights.size())), TRIANGLE_LIGHT_BUFFER_BINDING_INDEX);
+			lightNodeBuffer.InitData(sizeof(GPULightNode), uint32_t(std::max<size_t>(1, lightSampler.gpuNodes.size())), LIGHT_NODE_BUFFER_BINDING_INDEX);
+			lightEntryBuffer.InitData(sizeof(GPULightEntry), uint32_t(std::max<size_t>(1, lightSampler.gpuEntries.size())), LIGHT_ENTRY_BUFFER_BINDING_INDEX);
+
+			if (!scene->sphereLights.empty())
+			{
+				sphereLightBuffer.Bind();
+				sphereLightBuffer.LoadData(scene->sphereLights.front(), 0, uint32_t(scene->sphereLights.size()));
+				sphereLightBuffer.Unbind();
+			}
+			if (!scene->triangleLights.empty())
+			{
+				triangleLightBuffer.Bind();
+				triangleLightBuffer.LoadData(scene->triangleLights.front(), 0, uint32_t(scene->triangleLights.size()));
+				triangleLightBuffer.Unbind();
+			}
+			if (!lightSampler.gpuEntries.empty())
+			{
+				lightEntryBuffer.Bind();
+				lightEntryBuffer.LoadData(lightSampler.gpuEntries.front(), 0, uint32_t(lightSampler.gpuEntries.size()));
+				lightEntryBuffer.Unbind();
+			}
+			if (!lightSampler.gpuNodes.empty())
+			{
+				lightNodeBuffer.Bind();
+				lightNodeBuffer.LoadData(lightSampler.gpuNodes.front(), 0, uint32_t(lightSampler.gpuNodes.size()));
+				lightNodeBuffer.Unbind();
+			}
+
+			GPUMemory::LogBreakdown();
+		}
+
+		SceneKernels* SelectSceneKernels(const uint32_t& featureMask)
+		{
+			PROFILE_FUNCTION();
+			auto variant = kernelVariants.find(featureMask);
+			if (variant != kernelVariants.end())
+				return variant->second;
+
+			std::string defines = kernelDefines;
+			if (featureMask & FEATURE_SPHERES)			defines += "#define HAS_SPHERES\n";
+			if (featureMask & FEATURE_SPHERE_LIGHTS)	defines += "#define HAS_SPHERE_LIGHTS\n";
+			if (featureMask & FEATURE_MODELS)			defines += "#define HAS_MODELS\n";
+			if (featureMask & FEATURE_TRIANGLE_LIGHTS)	defines += "#define HAS_TRIANGLE_LIGHTS\n";
+			if (featureMask & FEATURE_TRANSMISSION)		defines += "#define HAS_TRANSMISSION\n";
+			if (featureMask & FEATURE_CLEARCOAT)		defines += "#define HAS_CLEARCOAT\n";
+
+			LOG_INFO("Compiling the kernels for scene feature mask ", featureMask, "...\n");
+			SceneKernels* sceneKernels = new SceneKernels();
+			sceneKernels->extend.ComputeShaderProgram("src/shaders/extend.glsl", defines);
+			sceneKernels->shade.ComputeShaderProgram("src/shaders/shade.glsl", defines);
+			sceneKernels->connect.ComputeShaderProgram("src/shaders/connect.glsl", defines);
+			sceneKernels->trace.ComputeShaderProgram("src/shaders/trace.glsl", defines);
+			sceneKernels->megakernel.ComputeShaderProgram("src/shaders/megakernel.glsl", defines);
+			if (shadowBenchmark)
+				sceneKernels->connectReference.ComputeShaderProgram("src/shaders/connect.glsl", defines + "#define REFERENCE_OCCLUSION\n");
+
+			sceneKernels->shade.Use();
+			sceneKernels->shade.SetUniformBool("u_regenerate", pathRegeneration);
+			for (ComputeShader* kernel : { &sceneKernels->shade, &sceneKernels->megakernel })
+			{
+				kernel->Use();
+				kernel->SetUniformBool("u_lightBVH", lightBVH);
+			}
+
+			kernelVariants[featureMask] = sceneKernels;
+			return sceneKernels;
 		}
 	}
 }
\ No newline at end of file
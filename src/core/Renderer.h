@@ -6,19 +6,59 @@
 #include "Settings.h"
 #include "Entity.h"
 #include "Scene.h"
+#include "LightSampler.h"
 #include "Events.h"
 #include "Window.h"
+#include "Capture.h"
 
-#define OUTPUT_TEX_BINDING		0
 #define ACCUMULATOR_TEX_BINDING 1
 #define SCENE_TEX_BINDING		2
+#define MOMENTS_TEX_BINDING		3
+
+#define READBACK_RING_SIZE		3
+
+// Frames a GPU timestamp may take to become available, GPU timers keep this many frames of batches in flight
+#define GPU_QUERY_LATENCY_FRAMES 3
+
+// Batches timed per pipeline when the render mode is benchmarked
+#define BENCHMARK_BATCHES		16
+
+// Seconds between two ray statistics reports
+#define RAY_STATS_INTERVAL		2.0
 
 namespace PT::Renderer
 {
+	// Kernels that depend on the scene's content, compiled once per scene feature mask
+	struct SceneKernels
+	{
+		ComputeShader extend;
+		ComputeShader shade;
+		ComputeShader connect;
+		ComputeShader trace;
+		ComputeShader megakernel;
+
+		// Only built for the shadow benchmark
+		ComputeShader connectReference;
+	};
+
 	void Init(const Settings& settings, Window& window);
-	void Update();
 	void Shutdown();
 
+	// A displayed frame is BeginFrame, any number of Render batches and Present
+	void BeginFrame();
+	void Render();
+	void Present();
+
+	uint32_t GetSamplesPerPixel();
+	// Pixel samples traced by the batches of the current frame
+	uint64_t GetFrameSamples();
+	double GetBatchTime();
+	bool IsConverged();
+	// Per stage GPU times for the window title, empty while the overlay is off
+	std::string GetProfilerOverlay();
+	// Saves the accumulated image in the background as the capture settings' output path + name
+	void SaveImage(const std::string& name);
+
 	namespace
 	{
 		inline uint32_t GetNumWorkGroups(const uint32_t& nwork)
@@ -26,11 +66,33 @@ namespace PT::Renderer
 			return std::max<uint32_t>(1, (uint32_t)glm::ceil((float)nwork / (float)MIN_WORK_GROUP_INVOCATION_X));
 		}
 
+		void MarkActivePixels(const bool& reset);
+		void ReadActivePixels();
+		void StartRayStats();
+		void CopyRayStats();
+		void ReadRayStats();
+		void ReportRayStats();
+		void RenderTile(const uint32_t& tileOffset, const uint32_t& tileSize);
+		void RenderTileMegakernel(const uint32_t& tileOffset, const uint32_t& tileSize);
+		RenderMode SelectRenderMode();
+		void RenderRegenerated(const uint32_t& nSamples);
+		void TraceBounce(const uint32_t& bounce);
+		void TraceBounceFused(const uint32_t& bounce);
+		void BeginStage(const char* kind, const uint32_t& index);
+		void BeginStage(const char* kind);
+		void EndStage();
+		void LogShadowBenchmark();
 		void SetDynamicUniforms();
+		void SetTileUniforms(const uint32_t& tileOffset, const uint32_t& tileSize);
+		template<typename T>
+		void SetUniform(const T& value, const size_t& offset);
+		void UploadUniforms();
 		void ResetWorkBuffers();
 		void ResetAccumulator();
+		void UpdateAutosave();
 		void SwapBuffers();
 		void OnEvent(Event* e);
 		void LoadScene(const std::string& filePath);
+		SceneKernels* SelectSceneKernels(const uint32_t& featureMask);
 	}
 }
\ No newline at end of file
@@ -1,10 +1,15 @@
 #include <PT.h>
 #include "Scene.h"
+#include "Profiler.h"
+#include "Settings.h"
 
 namespace PT
 {
 	Scene::Scene(const std::string& filePath)
 	{
+		// There is no scene file format yet, every path gets the scene built in LoadScene
+		if (filePath != BUILT_IN_SCENE)
+			LOG_WARNING("Scene files can't be loaded yet, rendering the built-in scene instead of ", filePath, "\n");
 		LoadScene();
 	}
 
@@ -15,6 +20,7 @@ namespace PT
 
 	void Scene::LoadScene()
 	{
+		PROFILE_FUNCTION();
 		camera = new PerspectiveCamera(glm::vec3(0.0f, 15.0f, -20.0f), glm::vec3(0.0f, 0.0f, 1.0f), 60.0f);
 
 		//		    roughness metal  spec  specT sheen sheenT clear clearR trans  IOR   SSS
@@ -28,7 +34,7 @@ namespace PT
 		SphereLight sl(glm::vec3(50.0), glm::vec3(5.0, 10.0, -5.0), 2.0);
 		sphereLights.emplace_back(sl);
 
-		HDRItexture = Texture("resources/assets/textures/hdri/apartment.hdr");
+		HDRItexture.Load("resources/assets/textures/hdri/apartment.hdr");
 
 		Transform transform;
 		transform.translation = glm::vec3(0.0f, -1.0f, 0.0f);
@@ -52,5 +58,73 @@ namespace PT
 			models[i].BuildBVH();
 		}
 		LOG("Done!\n");
+
+		// Triangles of emissive models become area lights, in the order the GPU stores them
+		for (Model& model : models)
+		{
+			const glm::vec3& emission = materials[model.matid].emission;
+			if (glm::max(emission.x, glm::max(emission.y, emission.z)) <= 0.0f)
+				continue;
+
+			model.lightOffset = uint32_t(triangleLights.size());
+			for (const GPUTriangle& triangle : model.gpuTriangles)
+				triangleLights.emplace_back(triangle.verts[0].localPos, triangle.verts[1].localPos, triangle.verts[2].localPos, emission);
+		}
+
+		BuildAnalyticBVH();
+	}
+
+	uint32_t Scene::GetFeatureMask() const
+	{
+		uint32_t mask = 0;
+		if (!spheres.empty())
+			mask |= FEATURE_SPHERES;
+		if (!sphereLights.empty())
+			mask |= FEATURE_SPHERE_LIGHTS;
+		if (!models.empty())
+			mask |= FEATURE_MODELS;
+		if (!triangleLights.empty())
+			mask |= FEATURE_TRIANGLE_LIGHTS;
+
+		for (const Material& material : materials)
+		{
+			if (material.transmission > 0.0f && material.metalness < 1.0f)
+				mask |= FEATURE_TRANSMISSION;
+			if (material.clearCoat > 0.0f)
+				mask |= FEATURE_CLEARCOAT;
+		}
+
+		return mask;
+	}
+
+	void Scene::BuildAnalyticBVH()
+	{
+		PROFILE_FUNCTION();
+		std::vector<Primitive> primitives;
+		auto addSphere = [&](const glm::vec3& center, const float& radius, const PrimitiveType&& type, const uint32_t& index)
+		{
+			Primitive primitive;
+			primitive.bounds.min = center - glm::vec3(radius);
+			primitive.bounds.max = center + glm::vec3(radius);
+			primitive.centroid = center;
+			primitive.type = type;
+			primitive.index = index;
+			primitives.emplace_back(std::move(primitive));
+		};
+
+		for (uint32_t i = 0; i < spheres.size(); ++i)
+			addSphere(spheres[i].worldPos, spheres[i].radius, PrimitiveType::Sphere, i);
+		for (uint32_t i = 0; i < sphereLights.size(); ++i)
+			addSphere(sphereLights[i].worldPos, sphereLights[i].radius, PrimitiveType::SphereLight, i);
+
+		// An empty tree would be a leaf without primitives, the kernels skip the traversal instead
+		if (primitives.empty())
+			return;
+
+		std::vector<const Primitive*> order;
+		BuildFlatBVH(primitives, analyticNodes, order);
+
+		for (const Primitive* i : order)
+			analyticPrimitives.emplace_back(uint32_t(i->type) << PRIMITIVE_TYPE_SHIFT | i->index);
 	}
 }
\ No newline at end of file
@@ -6,17 +6,24 @@
 #include "Logger.h"
 
 #define MAX_MATERIALS	   64
-#define MAX_SPHERE_LIGHTS  16
-#define MAX_SPHERES		   64
 #define MAX_MODELS		   8
 
 
 namespace PT
 {
+	// Content a scene uses, kernels are specialized on it so absent features cost nothing
+	enum SceneFeature : uint32_t
+	{
+		FEATURE_SPHERES			= 1 << 0,
+		FEATURE_SPHERE_LIGHTS	= 1 << 1,
+		FEATURE_MODELS			= 1 << 2,
+		FEATURE_TRIANGLE_LIGHTS = 1 << 3,
+		FEATURE_TRANSMISSION	= 1 << 4,
+		FEATURE_CLEARCOAT		= 1 << 5
+	};
+
 	constexpr size_t sceneBufferSize =
 		sizeof(Material) * MAX_MATERIALS +
-		sizeof(SphereLight) * MAX_SPHERE_LIGHTS +
-		sizeof(Sphere) * MAX_SPHERES +
 		sizeof(GPUModel) * MAX_MODELS;
 
 	class Scene 
@@ -28,15 +35,24 @@ namespace PT
 
 		public:
 			void LoadScene();
+			uint32_t GetFeatureMask() const;
+
+		private:
+			void BuildAnalyticBVH();
 
 		public:
 			PerspectiveCamera* camera;
 
-			Texture HDRItexture;
+			EnvironmentMap HDRItexture;
 			std::vector<Material> materials;
 			std::vector<SphereLight> sphereLights;
+			std::vector<TriangleLight> triangleLights;
 			std::vector<Sphere> spheres;
 			std::vector<Texture> textures;
 			std::vector<Model> models;
+
+			// BVH over spheres and sphere lights, leaves reference them through type tagged indices
+			std::vector<GPUBVHNode> analyticNodes;
+			std::vector<uint32_t> analyticPrimitives;
 	};
 }
\ No newline at end of file
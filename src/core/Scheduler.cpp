@@ -0,0 +1,37 @@
+#include <PT.h>
+#include "Scheduler.h"
+
+namespace PT
+{
+	FrameScheduler::FrameScheduler() : m_settings(), m_lastInteraction(0.0) {}
+
+	void FrameScheduler::Init(const SchedulerSettings& settings)
+	{
+		m_settings = settings;
+		m_settings.maxBatchesPerFrame = std::max<uint32_t>(1, m_settings.maxBatchesPerFrame);
+	}
+
+	void FrameScheduler::OnInteraction(const double& time)
+	{
+		m_lastInteraction = time;
+	}
+
+	uint32_t FrameScheduler::GetBatchCount(const double& batchTime) const
+	{
+		double budget = IsInteractive() ? m_settings.interactiveFrameTime : m_settings.idleFrameTime;
+		if (budget <= 0.0)
+			return m_settings.maxBatchesPerFrame;
+
+		// Until the first timing arrives render a single batch
+		if (batchTime <= 0.0)
+			return 1;
+
+		uint32_t nBatches = uint32_t(budget / batchTime);
+		return std::clamp<uint32_t>(nBatches, 1, m_settings.maxBatchesPerFrame);
+	}
+
+	bool FrameScheduler::IsInteractive() const
+	{
+		return glfwGetTime() - m_lastInteraction < m_settings.interactionTimeout;
+	}
+}
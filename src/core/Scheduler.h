@@ -0,0 +1,24 @@
+#pragma once
+#include "Settings.h"
+
+namespace PT
+{
+	// Decides how many render batches fit in each displayed frame. While the camera moves frames are kept
+	// within the interactive budget, once it settles the budget grows so more time goes to accumulation.
+	class FrameScheduler final
+	{
+		public:
+			explicit FrameScheduler();
+
+			void Init(const SchedulerSettings& settings);
+			void OnInteraction(const double& time);
+
+			// batchTime is the measured GPU time of one batch in milliseconds, zero if unknown
+			uint32_t GetBatchCount(const double& batchTime) const;
+			bool IsInteractive() const;
+
+		private:
+			SchedulerSettings m_settings;
+			double m_lastInteraction;
+	};
+}
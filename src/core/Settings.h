@@ -3,16 +3,137 @@
 
 namespace PT
 {
+	// Wavefront runs paths through the generate, extend, shade and connect kernels, megakernel traces each
+	// path in one invocation. Benchmark times both on the scene and keeps the faster one.
+	enum class RenderMode { Wavefront, Megakernel, Benchmark };
+
+	// EXR and PFM keep the linear radiance, PNG is tone mapped like the window
+	enum class ImageFormat { EXRHalf, EXRFloat, PFM, PNG };
+
+	// How the GL context of a headless run is created. Native uses the platform's API behind a hidden window,
+	// EGL and OSMesa need a GLFW built with them, OSMesa renders in software on machines without a GPU.
+	enum class ContextAPI { Native, EGL, OSMesa };
+
+	// The only scene there is, Scene builds it in code. Its path names it in the logs and render statistics.
+	constexpr const char* BUILT_IN_SCENE = "resources/scenes/default.scene";
+
 	struct VideoSettings
 	{
 		uint32_t width  = 1280;
 		uint32_t height = 720;
 		double fov		= 60.0;
 		double gamma	= 2.2;
+		bool vsync		= false;
+	};
+
+	struct RenderSettings
+	{
+		std::string scenePath = BUILT_IN_SCENE;
+
+		// Render target resolution, zero means the window's resolution
+		uint32_t width	= 0;
+		uint32_t height = 0;
+
+		// Wavefront work buffers are sized for this many paths, larger frames are rendered in tiles
+		uint32_t pathsInFlight = 1280 * 720;
+
+		// Samples per pixel traced by each batch, the scheduler decides how many batches a displayed frame gets
+		uint32_t samplesPerPixel = 1;
+
+		// Refill the slots of terminated paths with new camera samples instead of letting the queues drain
+		bool pathRegeneration = false;
+
+		// Stop sampling pixels once the standard error of their mean luminance, relative to the mean,
+		// drops below adaptiveThreshold. Every pixel takes at least adaptiveMinSamples first.
+		bool adaptiveSampling		= false;
+		float adaptiveThreshold		= 0.02f;
+		uint32_t adaptiveMinSamples = 16;
+
+		// Pick lights for next event estimation with the light BVH, otherwise proportionally to their power
+		bool lightBVH = true;
+
+		// Walk the BVH through the escape links of the flattened nodes instead of a per-thread stack
+		bool stacklessTraversal = true;
+
+		// Can be switched at runtime with M
+		RenderMode renderMode = RenderMode::Wavefront;
+
+		// Trace each bounce's shadow rays together with the next bounce's extension rays in one dispatch
+		bool fusedTraversal = false;
+	};
+
+	struct SchedulerSettings
+	{
+		// Time budget in milliseconds of each displayed frame, batches are rendered until the budget is spent.
+		// The idle budget applies once the camera has been still for interactionTimeout seconds, zero removes it.
+		double interactiveFrameTime = 16.0;
+		double idleFrameTime		= 250.0;
+		double interactionTimeout	= 0.25;
+
+		uint32_t maxBatchesPerFrame = 64;
+	};
+
+	struct ProfilerSettings
+	{
+		// Time every dispatch with GPU queries, the per stage statistics are written to outputPath on shutdown.
+		// Off by default as the queries cost a little per dispatch, the overlay turns it on while it is shown.
+		bool gpuStages = false;
+		std::string outputPath = "profile/";
+
+		// Show the per stage averages in the window title, can be toggled at runtime with P
+		bool overlay = false;
+
+		// Seconds between two frame time reports in the log, zero only keeps the summary written on shutdown
+		double reportInterval = 10.0;
+
+		// Build the tracing kernels with ray and traversal counters, reported in the log and the overlay
+		bool rayStats = false;
+
+		// Write a Chrome trace of the host side startup, and of the next traceFrames frames when T is pressed
+		bool traceStartup = false;
+		uint32_t traceFrames = 4;
+
+		// Alternate wavefront batches between the connect kernel and one built with the occlusion traversal shadow
+		// rays used before they got their own. Both are timed as GPU stages and compared in the log on shutdown.
+		bool shadowBenchmark = false;
+	};
+
+	struct CaptureSettings
+	{
+		// Renders saved with C and autosaves land in outputPath
+		std::string outputPath = "captures/";
+		ImageFormat format = ImageFormat::EXRHalf;
+
+		// Seconds between two autosaves of the accumulated image, zero disables them
+		double autosaveInterval = 0.0;
+
+		// Threads encoding the captured frames
+		uint32_t encoderThreads = 2;
+	};
+
+	struct HeadlessSettings
+	{
+		// Render without showing a window until the sample or time limit, save the image and exit
+		bool enabled = false;
+		ContextAPI contextAPI = ContextAPI::Native;
+
+		// Samples per pixel and seconds to render, zero removes a limit. Adaptive sampling may finish earlier.
+		uint32_t samplesPerPixel = 256;
+		double timeLimit		 = 0.0;
+
+		// The image is saved as the capture settings' output path + outputName, the render statistics in JSON
+		// go to statsPath, next to the image when empty
+		std::string outputName = "render";
+		std::string statsPath;
 	};
 
 	struct Settings
 	{
 		VideoSettings videoSettings;
+		RenderSettings renderSettings;
+		SchedulerSettings schedulerSettings;
+		ProfilerSettings profilerSettings;
+		CaptureSettings captureSettings;
+		HeadlessSettings headlessSettings;
 	};
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include <PT.h>
 #include "Shader.h"
+#include "Profiler.h"
 
 namespace PT
 {
@@ -104,17 +105,135 @@ namespace PT
 		}
 	}
 
+	namespace
+	{
+		// 64 bit FNV-1a, unlike std::hash it gives the same file name with every toolchain
+		std::string CacheFilePath(const std::string& identity)
+		{
+			uint64_t hash = 14695981039346656037ull;
+			for (const char& c : identity)
+			{
+				hash ^= uint64_t(static_cast<unsigned char>(c));
+				hash *= 1099511628211ull;
+			}
+			return SHADER_CACHE_DIR + std::to_string(hash) + ".bin";
+		}
+	}
+
+	std::string Shader::CacheIdentity(const std::string& source) const
+	{
+		std::string identity;
+		for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+		{
+			const char* str = reinterpret_cast<const char*>(glGetString(name));
+			identity.append(str ? str : "").append("\n");
+		}
+
+		return identity + source;
+	}
+
+	bool Shader::LoadProgramBinary(const std::string& identity)
+	{
+		std::ifstream file(CacheFilePath(identity), std::ios::binary);
+		if (!file.is_open())
+			return false;
+
+		// Header: identity length, identity, binary format, binary length. A hash collision or a stale file
+		// holds a different identity and is compiled over.
+		uint64_t identityLength = 0;
+		file.read(reinterpret_cast<char*>(&identityLength), sizeof(identityLength));
+		if (!file || identityLength != identity.size())
+			return false;
+
+		std::string storedIdentity(identity.size(), '\0');
+		file.read(storedIdentity.data(), std::streamsize(storedIdentity.size()));
+		if (!file || storedIdentity != identity)
+			return false;
+
+		GLenum format = 0;
+		GLsizei length = 0;
+		file.read(reinterpret_cast<char*>(&format), sizeof(format));
+		file.read(reinterpret_cast<char*>(&length), sizeof(length));
+		if (!file || length <= 0)
+			return false;
+
+		std::vector<char> binary(length);
+		file.read(binary.data(), length);
+		if (!file)
+			return false;
+
+		m_id = glCreateProgram();
+		glProgramBinary(m_id, format, binary.data(), length);
+
+		// The driver rejects binaries it can no longer use, e.g. after an update that kept the version string
+		int success;
+		glGetProgramiv(m_id, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			glDeleteProgram(m_id);
+			m_id = 0;
+			return false;
+		}
+
+		return true;
+	}
+
+	void Shader::StoreProgramBinary(const std::string& identity) const
+	{
+		int success, length = 0;
+		glGetProgramiv(m_id, GL_LINK_STATUS, &success);
+		glGetProgramiv(m_id, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (!success || length <= 0)
+			return;
+
+		std::vector<char> binary(length);
+		GLenum format = 0;
+		glGetProgramBinary(m_id, length, &length, &format, binary.data());
+
+		std::error_code error;
+		std::filesystem::create_directories(SHADER_CACHE_DIR, error);
+
+		std::ofstream file(CacheFilePath(identity), std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			LOG_WARNING("Failed to write the shader cache for: ", m_path, "\n");
+			return;
+		}
+
+		const uint64_t identityLength = identity.size();
+		file.write(reinterpret_cast<const char*>(&identityLength), sizeof(identityLength));
+		file.write(identity.data(), std::streamsize(identity.size()));
+		file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+		file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+		file.write(binary.data(), length);
+	}
+
 	// Compute shader
-	ComputeShader::ComputeShader(const std::string&& path)
+	ComputeShader::ComputeShader(const std::string&& path, const std::string& defines)
 	{
-		ComputeShaderProgram(std::forward<const std::string&&>(path));
+		ComputeShaderProgram(std::forward<const std::string&&>(path), defines);
 	}
 
-	void ComputeShader::ComputeShaderProgram(const std::string&& path)
+	void ComputeShader::ComputeShaderProgram(const std::string&& path, const std::string& defines)
 	{
+		PROFILE_FUNCTION();
 		std::string code = ReadFile(std::forward<const std::string>(path));
+
+		// Defines injected by the host go right after the version directive
+		code.insert(m_version.length() + 1, defines);
 		const char* shaderCode = code.c_str();
 
+		Timer timer;
+		timer.Start();
+
+		const std::string identity = CacheIdentity(code);
+		if (LoadProgramBinary(identity))
+		{
+			timer.Stop();
+			LOG_INFO("Loaded ", m_path, " from the shader cache in ", timer.GetMean(), " ms\n");
+			return;
+		}
+
 		// Compile
 		uint32_t shader;
 		shader = glCreateShader(GL_COMPUTE_SHADER);
@@ -124,11 +243,16 @@ namespace PT
 
 		// Link
 		m_id = glCreateProgram();
+		glProgramParameteri(m_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 		glAttachShader(m_id, shader);
 		glLinkProgram(m_id);
 		CheckLinkingErrors();
 
 		glDeleteShader(shader);
+
+		StoreProgramBinary(identity);
+		timer.Stop();
+		LOG_INFO("Compiled ", m_path, " in ", timer.GetMean(), " ms\n");
 	}
 
 	void ComputeShader::Dispatch(const uint32_t& x, const uint32_t& y, const uint32_t& z)
@@ -149,6 +273,7 @@ namespace PT
 
 	void PixelShader::PixelShaderProgram(const std::string&& path)
 	{
+		PROFILE_FUNCTION();
 		std::string code = ReadFile(std::forward<const std::string>(path));
 
 		// Vertex
@@ -161,6 +286,17 @@ namespace PT
 		compilingFragment.insert(m_version.length() + 1, m_defFragment);
 		const char* fragmentCode = compilingFragment.c_str();
 
+		Timer timer;
+		timer.Start();
+
+		const std::string identity = CacheIdentity(compilingVertex + compilingFragment);
+		if (LoadProgramBinary(identity))
+		{
+			timer.Stop();
+			LOG_INFO("Loaded ", m_path, " from the shader cache in ", timer.GetMean(), " ms\n");
+			return;
+		}
+
 		uint32_t vertex, fragment;
 		vertex = glCreateShader(GL_VERTEX_SHADER);
 		glShaderSource(vertex, 1, &vertexCode, NULL);
@@ -173,6 +309,7 @@ namespace PT
 		CheckCompilationErrors(std::forward<uint32_t>(fragment));
 
 		m_id = glCreateProgram();
+		glProgramParameteri(m_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 		glAttachShader(m_id, vertex);
 		glAttachShader(m_id, fragment);
 		glLinkProgram(m_id);
@@ -180,5 +317,9 @@ namespace PT
 
 		glDeleteShader(vertex);
 		glDeleteShader(fragment);
+
+		StoreProgramBinary(identity);
+		timer.Stop();
+		LOG_INFO("Compiled ", m_path, " in ", timer.GetMean(), " ms\n");
 	}
 }
\ No newline at end of file
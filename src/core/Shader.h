@@ -1,6 +1,9 @@
 #pragma once
 #include "Logger.h"
 
+// Linked program binaries are kept here between runs, one file per preprocessed source and driver
+#define SHADER_CACHE_DIR "shadercache/"
+
 namespace PT
 {
 	class Shader
@@ -25,10 +28,18 @@ namespace PT
 			void CheckCompilationErrors(const uint32_t&& shader) const;
 			void CheckLinkingErrors() const;
 
+			// A cached binary is identified by the vendor, renderer and driver version strings followed by the
+			// preprocessed source (defines included), so any of them changing falls back to compiling. The file
+			// is named after a hash of the identity and stores the identity itself, which is compared on load.
+			std::string CacheIdentity(const std::string& source) const;
+			bool LoadProgramBinary(const std::string& identity);
+			void StoreProgramBinary(const std::string& identity) const;
+
 		protected:
 			uint32_t m_id;
 			std::string m_path;
 			const std::string m_include = "#include ";
+			const std::string m_version = "#version 430 core";
 
 	};
 
@@ -36,8 +47,8 @@ namespace PT
 	{
 		public:
 			explicit ComputeShader() = default;
-			explicit ComputeShader(const std::string&& path);
-			void ComputeShaderProgram(const std::string&& path);
+			explicit ComputeShader(const std::string&& path, const std::string& defines = "");
+			void ComputeShaderProgram(const std::string&& path, const std::string& defines = "");
 			void Dispatch(const uint32_t& x, const uint32_t& y, const uint32_t& z);
 			void Barrier(uint32_t&& barrierBit);
 
@@ -51,7 +62,6 @@ namespace PT
 			void PixelShaderProgram(const std::string&& path);
 
 		private:
-			const std::string m_version		= "#version 430 core";
 			const std::string m_defVertex   = "#define COMPILING_VERTEX_SHADER\n";
 			const std::string m_defFragment = "#define COMPILING_FRAGMENT_SHADER\n";
 	};
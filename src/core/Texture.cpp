@@ -1,8 +1,26 @@
 #include <PT.h>
 #include "Texture.h"
+#include "Profiler.h"
 
 namespace PT
 {
+	namespace
+	{
+		size_t BytesPerTexel(const uint32_t& internalFormat)
+		{
+			switch (internalFormat)
+			{
+				case GL_RGBA32F: return 16;
+				case GL_RGB32F:	 return 12;
+				case GL_RGBA16F: return 8;
+				case GL_RGB16F:	 return 6;
+				case GL_R32F:	 return 4;
+				case GL_R32UI:	 return 4;
+				default:		 return 4;
+			}
+		}
+	}
+
 	Texture::Texture() : m_id(0), m_width(0), m_height(0) {}
 
 	Texture::Texture(const std::string&& path) : m_id(0), m_width(0), m_height(0)
@@ -15,8 +33,8 @@ namespace PT
 		{
 			m_width = width;
 			m_height = height;
-			glBindTexture(GL_TEXTURE_2D, m_id);
 			glGenTextures(1, &m_id);
+			glBindTexture(GL_TEXTURE_2D, m_id);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -24,6 +42,9 @@ namespace PT
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, m_width, m_height, 0, GL_RGB, GL_FLOAT, data);
 			glBindTexture(GL_TEXTURE_2D, 0);
 			stbi_image_free(data);
+
+			m_name = path;
+			TrackAllocation(GL_RGB16F);
 		}
 		else
 			LOG_WARNING("Failed to load texture at: ", path, "\n");
@@ -32,13 +53,30 @@ namespace PT
 	Texture::~Texture()
 	{
 		glDeleteTextures(1, &m_id);
+		GPUMemory::Free(m_allocation);
 	}
 
-	void Texture::LoadData(uint32_t&& internalFormat, GLenum&& format, GLenum&& type, const void* data) const
+	void Texture::LoadData(uint32_t&& internalFormat, GLenum&& format, GLenum&& type, const void* data)
 	{
 		Bind();
 		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, m_width, m_height, 0, format, type, data);
 		Unbind();
+		TrackAllocation(internalFormat);
+	}
+
+	void Texture::SetName(const std::string& name, const std::string& subsystem)
+	{
+		m_name = name;
+		m_subsystem = subsystem;
+	}
+
+	void Texture::TrackAllocation(const uint32_t& internalFormat)
+	{
+		size_t size = size_t(m_width) * m_height * BytesPerTexel(internalFormat);
+		if (m_allocation == GPU_NO_ALLOCATION)
+			m_allocation = GPUMemory::Allocate(m_name, m_subsystem, "texture", size);
+		else
+			GPUMemory::Resize(m_allocation, size);
 	}
 	
 	void Texture::BindTextureUnit(uint32_t&& internalFormat, GLenum&& access, uint32_t&& unit) const
@@ -66,4 +104,68 @@ namespace PT
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		glBindTexture(GL_TEXTURE_2D, 0);
 	}
+
+	void EnvironmentMap::Load(const std::string& path)
+	{
+		PROFILE_FUNCTION();
+		stbi_set_flip_vertically_on_load(true);
+		int width, height, nrComponents;
+		float* data = stbi_loadf(path.c_str(), &width, &height, &nrComponents, 3);
+
+		if (!data)
+		{
+			LOG_WARNING("Failed to load environment map at: ", path, "\n");
+			return;
+		}
+
+		m_width = width;
+		m_height = height;
+		glGenTextures(1, &m_id);
+		glBindTexture(GL_TEXTURE_2D, m_id);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, m_width, m_height, 0, GL_RGB, GL_FLOAT, data);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		m_name = path;
+		m_subsystem = "Scene";
+		TrackAllocation(GL_RGB16F);
+
+		BuildDistribution(data);
+		stbi_image_free(data);
+	}
+
+	void EnvironmentMap::BuildDistribution(const float* data)
+	{
+		PROFILE_FUNCTION();
+		const uint32_t rowSize = m_width + 1;
+		m_distribution.assign((m_height + 1) + m_height * rowSize, 0.0f);
+
+		float* marginal = &m_distribution[0];
+		for (uint32_t y = 0; y < m_height; ++y)
+		{
+			// Rows near the poles cover less solid angle
+			float sinTheta = std::sin(glm::pi<float>() * (float(y) + 0.5f) / float(m_height));
+			float* conditional = &m_distribution[(m_height + 1) + y * rowSize];
+
+			for (uint32_t x = 0; x < m_width; ++x)
+			{
+				const float* texel = &data[(y * m_width + x) * 3];
+				float luminance = 0.3f * texel[0] + 0.6f * texel[1] + 0.1f * texel[2];
+				conditional[x + 1] = conditional[x] + std::max(luminance, 0.0f) * sinTheta / float(m_width);
+			}
+
+			// The row's integral feeds the marginal distribution, black rows fall back to uniform
+			float rowIntegral = conditional[m_width];
+			marginal[y + 1] = marginal[y] + rowIntegral / float(m_height);
+			for (uint32_t x = 1; x <= m_width; ++x)
+				conditional[x] = rowIntegral > 0.0f ? conditional[x] / rowIntegral : float(x) / float(m_width);
+		}
+
+		float integral = marginal[m_height];
+		for (uint32_t y = 1; y <= m_height; ++y)
+			marginal[y] = integral > 0.0f ? marginal[y] / integral : float(y) / float(m_height);
+	}
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "Logger.h"
+#include "GPUMemory.h"
 
 namespace PT
 {
@@ -10,7 +11,7 @@ namespace PT
 			explicit Texture(const std::string&& path);
 			virtual ~Texture();
 	
-			virtual void LoadData(uint32_t&& internalFormat, GLenum&& format, GLenum&& type, const void* data) const;
+			virtual void LoadData(uint32_t&& internalFormat, GLenum&& format, GLenum&& type, const void* data);
 			virtual void BindTextureUnit(uint32_t&& internalFormat, GLenum&& access, uint32_t&& unit) const;
 			virtual void ActiveTexture(uint32_t&& unit) const;
 
@@ -21,10 +22,19 @@ namespace PT
 			inline virtual const uint32_t& GetWidth()	const { return m_width; }
 			inline virtual const uint32_t& GetHeight()	const { return m_height; }
 
+			// Labels the texture's storage in the GPU memory breakdown
+			void SetName(const std::string& name, const std::string& subsystem);
+
+		protected:
+			void TrackAllocation(const uint32_t& internalFormat);
+
 		protected:
 			uint32_t m_id;
 			uint32_t m_width;
 			uint32_t m_height;
+			std::string m_name = "texture";
+			std::string m_subsystem = "Renderer";
+			uint32_t m_allocation = GPU_NO_ALLOCATION;
 	};
 
 	class Image : public Texture
@@ -33,4 +43,22 @@ namespace PT
 			explicit Image() = default;
 			void Init(const uint32_t& width, const uint32_t& height);
 	};
+
+	// HDR environment map together with the piecewise constant distribution used to importance sample it.
+	// The distribution holds the marginal CDF over rows (height + 1 entries) followed by the conditional
+	// CDF of each row (width + 1 entries each), texels are weighted by luminance and sin(theta).
+	class EnvironmentMap : public Texture
+	{
+		public:
+			explicit EnvironmentMap() = default;
+			void Load(const std::string& path);
+
+			inline const std::vector<float>& GetDistribution() const { return m_distribution; }
+
+		private:
+			void BuildDistribution(const float* data);
+
+		private:
+			std::vector<float> m_distribution;
+	};
 }
\ No newline at end of file
@@ -39,9 +39,9 @@ namespace PT
 		glfwDestroyWindow(m_instance);
 	}
 
-	void Window::UpdateTitle(const uint32_t& fps, const uint32_t& spp) const
+	void Window::UpdateTitle(const uint32_t& fps, const uint32_t& spp, const std::string& overlay) const
 	{
-		std::string title = m_title + " (" + std::to_string(fps) + " FPS) - " + std::to_string(spp) + " [spp]";
+		std::string title = m_title + " (" + std::to_string(fps) + " FPS) - " + std::to_string(spp) + " [spp]" + overlay;
 		glfwSetWindowTitle(m_instance, title.c_str());
 	}
 
@@ -10,7 +10,7 @@ namespace PT
 			explicit Window(std::string&& title, uint32_t width, uint32_t height);
 			~Window();
 
-			void UpdateTitle(const uint32_t& fps, const uint32_t& spp) const;
+			void UpdateTitle(const uint32_t& fps, const uint32_t& spp, const std::string& overlay = "") const;
 
 			operator GLFWwindow* ();
 
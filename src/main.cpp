@@ -1,12 +1,17 @@
 #include <PT.h>
 #include "core/Application.h"
+#include "core/CommandLine.h"
 
-int main() 
+int main(int argc, char** argv) 
 {
 	using namespace PT;
+	Settings settings;
+	if (!ParseCommandLine(argc, argv, settings))
+		return 1;
+
 	Application app;
 	
-	app.Init();
+	app.Init(settings);
 	app.Run();
 	app.Shutdown();
 
@@ -9,8 +9,13 @@
 #include <any>
 #include <memory>
 #include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <limits>
 #include <algorithm>
+#include <cstring>
 
 // Data structures
 #include <vector>
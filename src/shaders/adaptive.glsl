@@ -0,0 +1,62 @@
+#version 430 core
+#include "include/globals.glsl"
+#include "include/buffers.glsl"
+#include "include/utils.glsl"
+
+layout(local_size_x = MIN_WORK_GROUP_INVOCATION_X) in;
+
+uniform bool u_resetAccumulator;
+uniform bool u_adaptive;
+uniform uint u_minSamples;
+uniform float u_threshold;
+
+shared uint activeScan[MIN_WORK_GROUP_INVOCATION_X];
+shared uint groupOffset;
+
+// Standard error of the pixel's mean luminance relative to the mean itself,
+// the small bias keeps dark pixels from demanding samples forever
+bool PixelConverged(in ivec2 pixelCoords)
+{
+	vec4 accumulated = imageLoad(accumulatorTex, pixelCoords);
+	float n = accumulated.w;
+	if(n < float(u_minSamples))
+		return false;
+
+	float mean = Luminance(accumulated.rgb) / n;
+	float secondMoment = imageLoad(momentsTex, pixelCoords).r / n;
+	float variance = max(secondMoment - mean * mean, 0.0) * n / (n - 1.0);
+	float stdError = sqrt(variance / n);
+
+	return stdError / (mean + 0.01) < u_threshold;
+}
+
+void main()
+{
+	uvec2 dims = imageSize(accumulatorTex);
+	uint tid = gl_GlobalInvocationID.x;
+	uint lid = gl_LocalInvocationID.x;
+
+	bool active = false;
+	if(tid < dims.x * dims.y)
+		active = u_resetAccumulator || !u_adaptive || !PixelConverged(ivec2(tid % dims.x, tid / dims.x));
+
+	// Inclusive scan of the group's flags keeps the active pixels in scanline order,
+	// so tiles of the active list stay spatially coherent
+	activeScan[lid] = active ? 1 : 0;
+	barrier();
+
+	for(uint stride = 1; stride < MIN_WORK_GROUP_INVOCATION_X; stride *= 2)
+	{
+		uint value = lid >= stride ? activeScan[lid - stride] : 0;
+		barrier();
+		activeScan[lid] += value;
+		barrier();
+	}
+
+	if(lid == MIN_WORK_GROUP_INVOCATION_X - 1)
+		groupOffset = atomicAdd(Active.count, activeScan[lid]);
+	barrier();
+
+	if(active)
+		Active.pixel[groupOffset + activeScan[lid] - 1] = tid;
+}
@@ -1,43 +1,74 @@
 #version 430 core
 #include "include/globals.glsl"
 #include "include/buffers.glsl"
+#include "include/utils.glsl"
 
 layout(local_size_x = MIN_WORK_GROUP_INVOCATION_X) in;
 
 uniform bool u_resetAccumulator;
-
-void ReinhardToneMapping(inout vec4 pixelColor)
-{
-	pixelColor /= pixelColor.w;
-	pixelColor = sqrt(pixelColor / (pixelColor + vec4(1.0)));
-}
+uniform bool u_regenerate;
 
 void main()
 {
-	uvec2 dims = imageSize(outputTex);
+	uvec2 dims = imageSize(accumulatorTex);
 	uint tid = gl_GlobalInvocationID.x;
 
-	if(tid >= dims.x * dims.y)
+	if(tid * u_samplesPerPixel >= u_tileSize || u_tileOffset + tid >= Active.count)
 		return;
 
-	uint x = uint(tid % dims.x);
-	uint y = uint(tid / dims.x);
+	uint pixel = Active.pixel[u_tileOffset + tid];
+	uint x = uint(pixel % dims.x);
+	uint y = uint(pixel / dims.x);
 	ivec2 pixelCoords = ivec2(x, y);
+
+	// Regenerated paths were splatted as they finished, resolve and clear their sums
+	vec4 radiance;
+	float moment;
+	if(u_regenerate)
+	{
+		uint idx = pixel * 5;
+		radiance = vec4(uintBitsToFloat(Splat.splat[idx + 0]),
+						uintBitsToFloat(Splat.splat[idx + 1]),
+						uintBitsToFloat(Splat.splat[idx + 2]),
+						float(Splat.splat[idx + 4]));
+		moment = uintBitsToFloat(Splat.splat[idx + 3]);
+
+		Splat.splat[idx + 0] = 0;
+		Splat.splat[idx + 1] = 0;
+		Splat.splat[idx + 2] = 0;
+		Splat.splat[idx + 3] = 0;
+		Splat.splat[idx + 4] = 0;
+	}
+	else
+	{
+		// The tile's paths hold u_samplesPerPixel consecutive samples per pixel, accumulate them in one pass
+		radiance = vec4(0.0);
+		moment = 0.0;
+		for(uint i = 0; i < u_samplesPerPixel; ++i)
+		{
+			vec3 L = Path.radiance[tid * u_samplesPerPixel + i];
+
+			// Samples with NaNs or Infs count as black
+			highp bvec3 nan = isnan(L);
+			highp bvec3 inf = isinf(L);
+			if(nan.x || nan.y || nan.z || inf.x || inf.y || inf.z)
+				L = BLACK;
+
+			float luminance = Luminance(L);
+			radiance += vec4(L, 1.0);
+			moment += luminance * luminance;
+		}
+	}
 	
 	vec4 pixelColor;
 	if(u_resetAccumulator)
-		pixelColor = vec4(Path.radiance[tid], 1.0);
+		pixelColor = radiance;
 	else
-		pixelColor = imageLoad(accumulatorTex, pixelCoords) + vec4(Path.radiance[tid], 1.0);
-	
-	// TODO: Refactor - Hacky way to deal with NaNs and Infs
-	highp bvec3 nan = isnan(Path.radiance[tid]);
-	highp bvec3 inf = isinf(Path.radiance[tid]);
-	if(nan.x || nan.y || nan.z || inf.x || inf.y || inf.z)
-		pixelColor = vec4(BLACK, 1.0);
+	{
+		pixelColor = imageLoad(accumulatorTex, pixelCoords) + radiance;
+		moment += imageLoad(momentsTex, pixelCoords).r;
+	}
 	
 	imageStore(accumulatorTex, pixelCoords, pixelColor);
-	
-	ReinhardToneMapping(pixelColor);
-	imageStore(outputTex, pixelCoords, pixelColor);
+	imageStore(momentsTex, pixelCoords, vec4(moment));
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
-layout(rgba32f, binding = 0) uniform image2D outputTex;
 layout(rgba32f, binding = 1) uniform image2D accumulatorTex;
+// Running sum of the squared luminance of each pixel's samples
+layout(r32f, binding = 3) uniform image2D momentsTex;
 
 layout(std140, binding = 0) uniform Uniforms
 {
@@ -10,6 +11,11 @@ layout(std140, binding = 0) uniform Uniforms
 	uint u_nSpheres;
 	uint u_nModels;
 	uint u_frame;
+	uint u_tileOffset;
+	uint u_tileSize;
+	uint u_samplesPerPixel;
+	uint u_sampleBase;
+	uint u_nLights;
 };
 
 layout(std430, binding = 1) buffer WorkGroupsCount
@@ -25,11 +31,14 @@ layout(std430, binding = 2) buffer Atomics
 	uint extendThreadCounter;
 	uint shadeThreadCounter;
 	uint connectThreadCounter;
+	uint sampleCounter;
+	// Work groups of the fused trace kernel, enough for both ray queues
+	uint traceWorkGroup;
 } Atomic;
 
 layout(std430, binding = 3) buffer ExtendBuffer
 {
-	Ray extendRay[MAX_WIDTH * MAX_HEIGHT * 2];
+	Ray extendRay[PATHS_IN_FLIGHT * 2];
 } ExtQueue;
 
 layout(std140, binding = 4) uniform Swap 
@@ -40,32 +49,100 @@ layout(std140, binding = 4) uniform Swap
 
 layout(std430, binding = 5) buffer ShadowBuffer
 {
-	Ray shadowRay[MAX_WIDTH * MAX_HEIGHT];
+	Ray shadowRay[PATHS_IN_FLIGHT];
 } ShadowQueue;
 
 layout(std430, binding = 6) buffer HitInfo
 {
-	vec3 point[MAX_WIDTH * MAX_HEIGHT];
-	vec3 lastPoint[MAX_WIDTH * MAX_HEIGHT];
-	vec3 N[MAX_WIDTH * MAX_HEIGHT];
-	vec3 V[MAX_WIDTH * MAX_HEIGHT];
-	float t[MAX_WIDTH * MAX_HEIGHT];
-	uint matid[MAX_WIDTH * MAX_HEIGHT];
-	bool emitter[MAX_WIDTH * MAX_HEIGHT];
+	vec2 barycentrics[PATHS_IN_FLIGHT];
+	float t[PATHS_IN_FLIGHT];
+	uint primid[PATHS_IN_FLIGHT];
+	uint instid[PATHS_IN_FLIGHT];
 } Intersection;
 
+// Sized on the host by GetPathBufferSize, keep the two in step
 layout(std430, binding = 7) buffer PathStates
 {
-	vec3 throughput[MAX_WIDTH * MAX_HEIGHT];
-	vec3 radiance[MAX_WIDTH * MAX_HEIGHT];
-	float mediumIOR[MAX_WIDTH * MAX_HEIGHT];
-	LightSampleRec lightSampleRec[MAX_WIDTH * MAX_HEIGHT];
+	vec3 throughput[PATHS_IN_FLIGHT];
+	vec3 radiance[PATHS_IN_FLIGHT];
+	float mediumIOR[PATHS_IN_FLIGHT];
+	uint pixel[PATHS_IN_FLIGHT];
+	uint depth[PATHS_IN_FLIGHT];
+	uint sampleIdx[PATHS_IN_FLIGHT];
+	LightSampleRec lightSampleRec[PATHS_IN_FLIGHT];
 } Path;
 
 layout(std430, binding = 8) buffer SceneHierarchy
 {
 	Material material[MAX_MATERIALS];
-	Sphere sphere[MAX_SPHERES];
-	SphereLight sphereLight[MAX_SPHERE_LIGHTS];
 	Model models[MAX_MODELS];
 } Scene;
+
+// Per pixel radiance (rgb) and sample count splatted by terminated paths in regeneration mode
+layout(std430, binding = 9) buffer SplatBuffer
+{
+	uint splat[];
+} Splat;
+
+// Pixels whose error estimate is still above the threshold, rebuilt before every batch
+layout(std430, binding = 10) buffer ActivePixels
+{
+	uint count;
+	uint pixel[];
+} Active;
+
+// Environment map distribution, the marginal CDF over rows followed by the conditional CDF of each row
+layout(std430, binding = 11) buffer EnvironmentDistribution
+{
+	uint width;
+	uint height;
+	float cdf[];
+} Env;
+
+layout(std430, binding = 12) buffer SphereLightBuffer
+{
+	SphereLight sphereLight[];
+} SphereLights;
+
+// Triangles of emissive meshes, a model's triangles start at its light offset
+layout(std430, binding = 15) buffer TriangleLightBuffer
+{
+	TriangleLight triangleLight[];
+} TriangleLights;
+
+layout(std430, binding = 16) buffer SphereBuffer
+{
+	Sphere sphere[];
+} Spheres;
+
+// BVH over spheres and sphere lights, see Scene::BuildAnalyticBVH
+layout(std430, binding = 17) buffer AnalyticTree
+{
+	BVHNode node[];
+} AnalyticBVH;
+
+layout(std430, binding = 18) buffer AnalyticPrimitiveBuffer
+{
+	uint ref[];
+} AnalyticPrimitives;
+
+// Light sampling structures, see LightSampler
+layout(std430, binding = 13) buffer LightTree
+{
+	LightNode node[];
+} LightBVH;
+
+layout(std430, binding = 14) buffer LightTable
+{
+	LightEntry entry[];
+} Lights;
+
+// Ray statistics of the current batch, only written by kernels built with RAY_STATS
+layout(std430, binding = 19) buffer RayStatistics
+{
+	uint extendRays;
+	uint shadowRays;
+	uint nodesVisited;
+	uint primitivesTested;
+	uint activePaths[MAX_DEPTH + 1];
+} Stats;
@@ -0,0 +1,41 @@
+void StartPathState(in uint pathid, in uint pixel, in uint sampleIdx)
+{
+	Path.throughput[pathid]	= vec3(1.0);
+	Path.radiance[pathid]	= vec3(0.0);
+	Path.mediumIOR[pathid]	= 1.0;
+	Path.pixel[pathid]		= pixel;
+	Path.depth[pathid]		= 0;
+	Path.sampleIdx[pathid]	= sampleIdx;
+
+	Path.lightSampleRec[pathid].bsdfEval = vec3(0.0);
+	Path.lightSampleRec[pathid].emission = vec3(0.0);
+	Path.lightSampleRec[pathid].bsdfPdf  = 0.0;
+	Path.lightSampleRec[pathid].lightPdf = 0.0;
+	Path.lightSampleRec[pathid].dist = INFINITY;
+};
+
+Ray GeneratePrimaryRay(in uint pathid, in uint pixel)
+{
+	uvec2 dims = imageSize(accumulatorTex);
+	float aspectRatio = float(dims.x) / float(dims.y);
+	float FOV = tan(radians(u_FOV / 2.0));
+
+	vec2 antiAliasing = Sample2D(DIM_CAMERA);
+	float xoffset = antiAliasing.x;
+	float yoffset = antiAliasing.y;
+	
+	uvec2 pixelCoords = uvec2(uint(pixel % dims.x), uint(pixel / dims.x));
+	
+	float x = (float((pixelCoords.x + xoffset) * 2.0 - dims.x) / dims.x) * aspectRatio * FOV;
+	float y = (float((pixelCoords.y + yoffset) * 2.0 - dims.y) / dims.y) * FOV;
+	
+	vec3 rayOriginToWorld = vec3(vec4(0.0, 0.0, 0.0, 1.0) * u_camView);
+	vec3 rayDirToWorld = vec3(vec4(x, y, -1.0, 1.0) * u_camView);
+	
+	Ray r;
+	r.origin = u_camWorldPos;
+	r.dir = normalize(rayDirToWorld - rayOriginToWorld);
+	r.pathid = pathid;
+	
+	return r;
+}
@@ -0,0 +1,94 @@
+// Environment map lookup and importance sampling through the piecewise constant
+// distribution built on the host, see EnvironmentMap
+
+#define ENV_EXPOSURE 3.0
+
+uniform sampler2D u_HDRI;
+uniform bool u_environment;
+
+vec2 EnvironmentUV(in vec3 dir)
+{
+	return vec2((PI + atan(dir.z, dir.x)) * (1.0 / TWO_PI), acos(-dir.y) * (1.0 / PI));
+}
+
+vec3 EnvironmentDirection(in vec2 uv)
+{
+	float phi = uv.x * TWO_PI - PI;
+	float theta = uv.y * PI;
+	return vec3(sin(theta) * cos(phi), -cos(theta), sin(theta) * sin(phi));
+}
+
+vec3 EnvironmentRadiance(in vec3 dir)
+{
+	return ENV_EXPOSURE * texture(u_HDRI, EnvironmentUV(dir)).rgb;
+}
+
+// Probability of picking the environment over the sphere lights for next event estimation
+float EnvironmentSelectPdf()
+{
+	if(!u_environment)
+		return 0.0;
+
+	return u_nLights > 0 ? 0.5 : 1.0;
+}
+
+// Interval of the CDF stored at offset with n + 1 entries that contains u
+uint FindInterval(in uint offset, in uint n, in float u)
+{
+	uint first = 0;
+	uint last = n;
+	while(first + 1 < last)
+	{
+		uint middle = (first + last) / 2;
+		if(Env.cdf[offset + middle] <= u)
+			first = middle;
+		else
+			last = middle;
+	}
+
+	return first;
+}
+
+// Solid angle pdf of the texel pair (x, y) seen from a direction with the given sin(theta)
+float EnvironmentTexelPdf(in uint x, in uint y, in float sinTheta)
+{
+	if(sinTheta <= 0.0)
+		return 0.0;
+
+	uint row = Env.height + 1 + y * (Env.width + 1);
+	float pdfV = (Env.cdf[y + 1] - Env.cdf[y]) * float(Env.height);
+	float pdfU = (Env.cdf[row + x + 1] - Env.cdf[row + x]) * float(Env.width);
+
+	return pdfV * pdfU / (2.0 * PI * PI * sinTheta);
+}
+
+float EnvironmentPdf(in vec3 dir)
+{
+	vec2 uv = EnvironmentUV(dir);
+	uint x = min(uint(uv.x * float(Env.width)), Env.width - 1);
+	uint y = min(uint(uv.y * float(Env.height)), Env.height - 1);
+
+	return EnvironmentTexelPdf(x, y, sin(uv.y * PI));
+}
+
+LightSample SampleEnvironment(in vec2 Xi)
+{
+	// Pick a row from the marginal distribution, then a texel from the row's conditional one
+	uint y = FindInterval(0, Env.height, Xi.y);
+	float dv = (Xi.y - Env.cdf[y]) / max(Env.cdf[y + 1] - Env.cdf[y], EPSILON);
+
+	uint row = Env.height + 1 + y * (Env.width + 1);
+	uint x = FindInterval(row, Env.width, Xi.x);
+	float du = (Xi.x - Env.cdf[row + x]) / max(Env.cdf[row + x + 1] - Env.cdf[row + x], EPSILON);
+
+	vec2 uv = vec2((float(x) + clamp(du, 0.0, 1.0)) / float(Env.width), (float(y) + clamp(dv, 0.0, 1.0)) / float(Env.height));
+	vec3 dir = EnvironmentDirection(uv);
+
+	LightSample ls;
+	ls.lightDir = dir;
+	ls.dist = INFINITY;
+	ls.emission = EnvironmentRadiance(dir);
+	ls.pdf = EnvironmentTexelPdf(x, y, sin(uv.y * PI));
+
+	return ls;
+}
@@ -1,14 +1,11 @@
 // Renderer settings
+// PATHS_IN_FLIGHT is injected by the renderer and sizes the wavefront work buffers, MAX_DEPTH is injected
+// from the host's MAX_BOUNCES which sizes the ray statistics
 #define MIN_WORK_GROUP_INVOCATION_X 1024
-#define MAX_WIDTH	 1920
-#define MAX_HEIGHT	 1080
-#define MAX_DEPTH	 8
 #define RR_MAX_DEPTH 4
 
 // Scene buffer specifics
 #define MAX_MATERIALS		64
-#define MAX_SPHERE_LIGHTS	16
-#define MAX_SPHERES			64
 #define MAX_MODELS			8
 #define MAX_TRIANGLES		100000
 #define MAX_NODES			100000
@@ -30,6 +27,20 @@
 #define MAX_VERTS 50000
 #define MAX_IDX	  100000
 
+// Hit record instance ids of the non-mesh primitives
+#define INSTANCE_SPHERE		  0xFFFFFFFEu
+#define INSTANCE_SPHERE_LIGHT 0xFFFFFFFDu
+
+// Type tags of the analytic BVH's primitive references, the low bits hold the index
+#define PRIMITIVE_TYPE_SHIFT  30
+#define PRIMITIVE_INDEX_MASK  0x3FFFFFFFu
+#define PRIMITIVE_SPHERE	  1u
+#define PRIMITIVE_SPHERE_LIGHT 2u
+
+// Model light offset of non emissive meshes
+#define NO_LIGHT 0xFFFFFFFFu
+
+// Mirrored on the host in Buffer.h to size the path buffer
 struct LightSampleRec
 {
 	vec3  bsdfEval;
@@ -55,6 +66,16 @@ struct Ray
 	uint pathid;
 };
 
+// Compact hit written by the extend kernel
+struct HitRecord
+{
+	float t;
+	vec2 barycentrics;
+	uint primid;
+	uint instid;
+};
+
+// Shading data rebuilt from a HitRecord by the shade kernel
 struct Hit
 {
 	vec3 point;
@@ -82,6 +103,43 @@ struct SphereLight
 	float area;
 };
 
+// World space triangle of an emissive mesh, emitting from both faces
+struct TriangleLight
+{
+	vec3 p0;
+	float area;
+	vec3 p1;
+	float _pad0;
+	vec3 p2;
+	float _pad1;
+	vec3 emission;
+	float _pad2;
+};
+
+// Light BVH node in preorder, the first child follows its parent and leaves hold one light
+struct LightNode
+{
+	vec3 boundMin;
+	float phi;
+	vec3 boundMax;
+	uint secondChildOrLight;
+	vec3 axis;
+	float cosThetaO;
+	float cosThetaE;
+	uint isLeaf;
+	uint twoSided;
+	uint _pad;
+};
+
+// Alias table entry and power pmf of a light, trail is its path from the light BVH root
+struct LightEntry
+{
+	float aliasProb;
+	uint alias;
+	float pmf;
+	uint trail;
+};
+
 struct Vertex
 {
 	vec3 pos;
@@ -99,6 +157,8 @@ struct BVHNode
 	int secondChildOffset;
 	vec3 boundMax;
 	int nPrimitives;
+	int escapeOffset;
+	int _pad[3];
 };
 
 struct Model
@@ -106,7 +166,8 @@ struct Model
 	Triangle triangles[MAX_TRIANGLES];
 	BVHNode bvhnodes[MAX_NODES];
 	uint matid;
-	uint _pad[3];
+	uint lightOffset;
+	uint _pad[2];
 };
 
 struct Material 
@@ -127,5 +188,5 @@ struct Material
 	float subsurface;
 };
 
-// Internal RNG state
-uvec4 seed;
\ No newline at end of file
+// Sampler state (pixel, sample index, first dimension), see sampler.glsl
+uvec3 samplerState;
\ No newline at end of file
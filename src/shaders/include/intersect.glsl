@@ -6,37 +6,40 @@ void FetchSphereData(in Sphere s, in float t, in Ray r, inout Hit hit)
 	hit.matid = s.matid;
 }
 
-void FetchSphereLightData(in SphereLight sl, in float t, in Ray r, inout Hit hit)
+void FetchSphereLightData(in SphereLight sl, in float t, in Ray r, inout Hit hit, inout LightSampleRec rec)
 {
 	hit.t = t;
 	hit.point = r.origin + r.dir * t;
 	hit.N = normalize(hit.point - sl.worldPos);
 	hit.emitter = true;
 
-	float cosTheta = dot(hit.V, normalize(r.origin - hit.point));
+	// Light sampling picks points on the hemisphere facing the shading point
+	float cosTheta = abs(dot(hit.N, hit.V));
 	float dist = distance(hit.point, r.origin);
-	Path.lightSampleRec[r.pathid].lightPdf = dist * dist / (sl.area * cosTheta);
-	Path.lightSampleRec[r.pathid].emission = sl.emittance;
+	rec.lightPdf = dist * dist / (0.5 * sl.area * cosTheta);
+	rec.emission = sl.emittance;
 }
 
-void FetchTriangleData(in Triangle triangle, in uint matid, in float t, in Ray r, inout Hit hit)
-{		
-	vec3 v0v1 = triangle.vert[1].pos - triangle.vert[0].pos;
-	vec3 v0v2 = triangle.vert[2].pos - triangle.vert[0].pos;
+void FetchTriangleLightData(in TriangleLight tl, in Ray r, inout Hit hit, inout LightSampleRec rec)
+{
+	hit.emitter = true;
 
-	vec3 pvec	 = cross(r.dir, v0v2);
-	float det	 = dot(v0v1, pvec);
-	float invDet = 1.0 / det;
-	vec3 tvec	 = r.origin - triangle.vert[0].pos;
-	vec3 qvec	 = cross(tvec, v0v1);
+	vec3 normal = normalize(cross(tl.p1 - tl.p0, tl.p2 - tl.p0));
+	float cosTheta = abs(dot(normal, hit.V));
+	float dist = distance(hit.point, r.origin);
+	rec.lightPdf = dist * dist / (tl.area * cosTheta);
+	rec.emission = tl.emission;
+}
 
-	float u = dot(tvec, pvec) * invDet;
-	float v = dot(r.dir, qvec) * invDet;
+void FetchTriangleData(in Triangle triangle, in uint matid, in float t, in vec2 barycentrics, in Ray r, inout Hit hit)
+{
+	float u = barycentrics.x;
+	float v = barycentrics.y;
 
 	hit.t = t;
 	hit.point = r.origin + r.dir * t;
 	hit.N = normalize(u * triangle.vert[1].normal + v * triangle.vert[2].normal + (1.0 - u - v) * triangle.vert[0].normal);
-	//hit.N = normalize(cross(v0v1, v0v2));
+	//hit.N = normalize(cross(triangle.vert[1].pos - triangle.vert[0].pos, triangle.vert[2].pos - triangle.vert[0].pos));
 	hit.matid = matid;
 }
 
@@ -94,7 +97,7 @@ bool HitSphere(in Sphere s, in Ray r)
 	return false;
 }
 
-float IntersectTriangle(in Triangle triangle, in Ray r)
+float IntersectTriangle(in Triangle triangle, in Ray r, out vec2 barycentrics)
 {
 	vec3 v0v1 = triangle.vert[1].pos - triangle.vert[0].pos;
 	vec3 v0v2 = triangle.vert[2].pos - triangle.vert[0].pos;
@@ -124,9 +127,16 @@ float IntersectTriangle(in Triangle triangle, in Ray r)
 	if(t < 0.0) 
 		return INFINITY;
 
+	barycentrics = vec2(u, v);
 	return t;
 }
 
+float IntersectTriangle(in Triangle triangle, in Ray r)
+{
+	vec2 barycentrics;
+	return IntersectTriangle(triangle, r, barycentrics);
+}
+
 bool HitTriangle(in Triangle triangle, in Ray r)
 {
 	vec3 v0v1 = triangle.vert[1].pos - triangle.vert[0].pos;
@@ -168,4 +178,19 @@ float IntersectAABB(in BVHNode node, in vec3 invDir, in Ray r)
 	float tFar = min(tmax.x, min(tmax.y, tmax.z));
 
 	return (tFar >= tNear) ? (tNear > 0.0 ? tNear : tFar) : -1.0;
-}
\ No newline at end of file
+}
+
+// Slab test clipped to the ray interval [tMin, tMax], used by occlusion queries that only need a yes or no
+bool OverlapAABB(in BVHNode node, in vec3 invDir, in Ray r, in float tMin, in float tMax)
+{
+	vec3 near = (node.boundMin - r.origin) * invDir;
+	vec3 far = (node.boundMax - r.origin) * invDir;
+
+	vec3 tmin = min(far, near);
+	vec3 tmax = max(far, near);
+
+	float tNear = max(tMin, max(tmin.x, max(tmin.y, tmin.z)));
+	float tFar = min(tMax, min(tmax.x, min(tmax.y, tmax.z)));
+
+	return tFar >= tNear;
+}
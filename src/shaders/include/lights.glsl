@@ -0,0 +1,176 @@
+// Light selection for next event estimation, either from the power alias table or by descending
+// the light BVH with the importance of each child seen from the shading point (Conty Estevez and Kulla 2018).
+// The receiver's normal is left out of the importance so the pmf of a light hit by a BSDF ray can be
+// recomputed from the ray origin alone.
+
+uniform bool u_lightBVH;
+
+float CosSubClamped(in float sinA, in float cosA, in float sinB, in float cosB)
+{
+	return cosA > cosB ? 1.0 : cosA * cosB + sinA * sinB;
+}
+
+float SinSubClamped(in float sinA, in float cosA, in float sinB, in float cosB)
+{
+	return cosA > cosB ? 0.0 : sinA * cosB - cosA * sinB;
+}
+
+float LightNodeImportance(in vec3 p, in LightNode node)
+{
+	vec3 pc = 0.5 * (node.boundMin + node.boundMax);
+	float radius = 0.5 * length(node.boundMax - node.boundMin);
+	float dist2 = dot(p - pc, p - pc);
+	float d2 = max(dist2, radius * radius);
+
+	// Inside the bounding sphere every emission direction may reach the point
+	if(dist2 <= radius * radius)
+		return node.phi / d2;
+
+	// Angle between the emission axis and the direction toward the point
+	vec3 wi = normalize(p - pc);
+	float cosThetaW = dot(node.axis, wi);
+	if(node.twoSided != 0)
+		cosThetaW = abs(cosThetaW);
+	float sinThetaW = sqrt(max(0.0, 1.0 - cosThetaW * cosThetaW));
+
+	// Directions subtended by the node's bounding sphere
+	float cosThetaB = sqrt(max(0.0, 1.0 - radius * radius / dist2));
+	float sinThetaB = sqrt(max(0.0, 1.0 - cosThetaB * cosThetaB));
+
+	// Smallest angle between the point and any emission direction, cos(max(0, thetaW - thetaO - thetaB))
+	float sinThetaO = sqrt(max(0.0, 1.0 - node.cosThetaO * node.cosThetaO));
+	float cosThetaX = CosSubClamped(sinThetaW, cosThetaW, sinThetaO, node.cosThetaO);
+	float sinThetaX = SinSubClamped(sinThetaW, cosThetaW, sinThetaO, node.cosThetaO);
+	float cosThetaP = CosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+
+	if(cosThetaP <= node.cosThetaE)
+		return 0.0;
+
+	return node.phi * cosThetaP / d2;
+}
+
+uint SampleLightBVH(in vec3 p, in float u, out float pmf)
+{
+	uint idx = 0;
+	LightNode node = LightBVH.node[0];
+	pmf = 1.0;
+
+	if(node.isLeaf != 0)
+	{
+		if(LightNodeImportance(p, node) <= 0.0)
+			pmf = 0.0;
+		return node.secondChildOrLight;
+	}
+
+	while(node.isLeaf == 0)
+	{
+		float c0 = LightNodeImportance(p, LightBVH.node[idx + 1]);
+		float c1 = LightNodeImportance(p, LightBVH.node[node.secondChildOrLight]);
+		if(c0 == 0.0 && c1 == 0.0)
+		{
+			pmf = 0.0;
+			return 0;
+		}
+
+		// Pick a child proportionally to its importance and remap u for the next level
+		float p0 = c0 / (c0 + c1);
+		if(u < p0)
+		{
+			idx = idx + 1;
+			u = min(u / p0, 0.99999994);
+			pmf *= p0;
+		}
+		else
+		{
+			idx = node.secondChildOrLight;
+			u = min((u - p0) / (1.0 - p0), 0.99999994);
+			pmf *= 1.0 - p0;
+		}
+
+		node = LightBVH.node[idx];
+	}
+
+	return node.secondChildOrLight;
+}
+
+float LightBVHPmf(in vec3 p, in uint lightIdx)
+{
+	LightEntry entry = Lights.entry[lightIdx];
+	if(entry.pmf == 0.0)
+		return 0.0;
+
+	uint idx = 0;
+	uint trail = entry.trail;
+	LightNode node = LightBVH.node[0];
+	float pmf = 1.0;
+
+	// Follow the light's trail, weighing the chosen child against its sibling at every level
+	while(node.isLeaf == 0)
+	{
+		float c0 = LightNodeImportance(p, LightBVH.node[idx + 1]);
+		float c1 = LightNodeImportance(p, LightBVH.node[node.secondChildOrLight]);
+		if(c0 == 0.0 && c1 == 0.0)
+			return 0.0;
+
+		if((trail & 1u) != 0u)
+		{
+			pmf *= c1 / (c0 + c1);
+			idx = node.secondChildOrLight;
+		}
+		else
+		{
+			pmf *= c0 / (c0 + c1);
+			idx = idx + 1;
+		}
+
+		trail >>= 1u;
+		node = LightBVH.node[idx];
+	}
+
+	return pmf;
+}
+
+uint SampleLightAlias(in float u, out float pmf)
+{
+	float scaled = u * float(u_nLights);
+	uint idx = min(uint(scaled), u_nLights - 1);
+
+	LightEntry entry = Lights.entry[idx];
+	if(scaled - float(idx) >= entry.aliasProb)
+		idx = entry.alias;
+
+	pmf = Lights.entry[idx].pmf;
+	return idx;
+}
+
+// Pick a light for the shading point p, pmf is zero when no light can contribute
+uint SampleLight(in vec3 p, in float u, out float pmf)
+{
+	if(u_lightBVH)
+		return SampleLightBVH(p, u, pmf);
+
+	return SampleLightAlias(u, pmf);
+}
+
+float LightPmf(in vec3 p, in uint lightIdx)
+{
+	if(u_lightBVH)
+		return LightBVHPmf(p, lightIdx);
+
+	return Lights.entry[lightIdx].pmf;
+}
+
+
+// Sample the lightIdx-th light, sphere lights come first. Light kinds the scene lacks are compiled out.
+LightSample SampleLightSource(in uint lightIdx, in vec3 p, in vec2 Xi)
+{
+#if defined(HAS_SPHERE_LIGHTS) && defined(HAS_TRIANGLE_LIGHTS)
+	if(lightIdx < u_nSphereLights)
+		return SampleSphereLight(SphereLights.sphereLight[lightIdx], p, Xi);
+	return SampleTriangleLight(TriangleLights.triangleLight[lightIdx - u_nSphereLights], p, Xi);
+#elif defined(HAS_TRIANGLE_LIGHTS)
+	return SampleTriangleLight(TriangleLights.triangleLight[lightIdx - u_nSphereLights], p, Xi);
+#else
+	return SampleSphereLight(SphereLights.sphereLight[lightIdx], p, Xi);
+#endif
+}
\ No newline at end of file
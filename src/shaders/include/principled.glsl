@@ -151,23 +151,24 @@ vec3 EvalClearCoat(in Material mat, in vec3 N, in vec3 V, in vec3 L, in vec3 H,
 	return vec3(0.25 * mat.clearCoat * D * G * F);
 }
 
-void PrincipledSample(in uint tid, in uint pathid, in Material mat, inout vec3 N, inout vec3 V, inout vec3 L, inout vec3 H, inout vec3 bsdf, inout float pdf)
+void PrincipledSample(in Hit hit, in float mediumIOR, in Material mat, inout vec3 N, inout vec3 V, inout vec3 L, inout vec3 H, inout vec3 bsdf, inout float pdf)
 {
 	bsdf = BLACK;
 	pdf = 1.0;
 
-	float p = Rand();
-	vec2 Xi = Rand2();
+	float p = Sample1D(DIM_LOBE);
+	vec2 Xi = Sample2D(DIM_BSDF);
 
 	float transWeight = (1.0 - mat.metalness) * mat.transmission;
 	float diffuseWeight = 0.5 * (1.0 - mat.metalness);
 	float primarySpecRatio = 1.0 / (1.0 + mat.clearCoat);
 
+#ifdef HAS_TRANSMISSION
 	// Transmission
 	if(p < transWeight) 
 	{
 		bool fromOutside = dot(-V, N) < 0.0;
-		float eta = fromOutside ? (Path.mediumIOR[pathid] / mat.IOR) : (mat.IOR / Path.mediumIOR[pathid]);
+		float eta = fromOutside ? (mediumIOR / mat.IOR) : (mat.IOR / mediumIOR);
 
 		vec3 GGX = ImportanceSampleGGX(Xi.xy, mat.roughness);	
 		N = fromOutside ? N : -N;
@@ -177,7 +178,7 @@ void PrincipledSample(in uint tid, in uint pathid, in Material mat, inout vec3 N
 		float F = DielectricFresnel(abs(dot(R, H)), eta);
 		
 		// Reflect
-		if(Rand() < F) 
+		if(Sample1D(DIM_FRESNEL) < F) 
 		{
 			L = normalize(R);
 			bsdf = EvalDielectricReflection(mat, N, V, L, H, pdf);
@@ -193,7 +194,7 @@ void PrincipledSample(in uint tid, in uint pathid, in Material mat, inout vec3 N
 		// Absorption
 		if(!fromOutside)
 		{
-			float dist = distance(Intersection.point[tid], Intersection.lastPoint[tid]);
+			float dist = distance(hit.point, hit.lastPoint);
 			bsdf *= exp(-dist * mat.density);
 		}
 	
@@ -201,6 +202,7 @@ void PrincipledSample(in uint tid, in uint pathid, in Material mat, inout vec3 N
 		pdf *= transWeight;
 	}
 	else 
+#endif
 	{
 		// Diffuse
 		if(p < diffuseWeight)
@@ -214,7 +216,9 @@ void PrincipledSample(in uint tid, in uint pathid, in Material mat, inout vec3 N
 		else
 		{
 			// Specular
+#ifdef HAS_CLEARCOAT
 			if(p < primarySpecRatio) 
+#endif
 			{
 				vec3 GGX = ImportanceSampleGGX(Xi, mat.roughness);
 				H = ToWorldSpace(GGX, N);
@@ -222,6 +226,7 @@ void PrincipledSample(in uint tid, in uint pathid, in Material mat, inout vec3 N
 				bsdf = EvalSpecularReflection(mat, N, V, L, H, pdf);
 				pdf *= primarySpecRatio * (1.0 - diffuseWeight);
 			}
+#ifdef HAS_CLEARCOAT
 			// Clearcoat
 			else 
 			{
@@ -231,20 +236,21 @@ void PrincipledSample(in uint tid, in uint pathid, in Material mat, inout vec3 N
 				bsdf = EvalClearCoat(mat, N, V, L, H, pdf);
 				pdf *= (1.0 - primarySpecRatio) * (1.0 - diffuseWeight);
 			}
+#endif
 		}
 		bsdf *= (1.0 - transWeight);
 		pdf *= (1.0 - transWeight);
 	}
 }
 
-void PrincipledEval(in uint tid, in uint pathid, in Material mat, in vec3 N, in vec3 V, in vec3 L, inout vec3 bsdf, inout float pdf)
+void PrincipledEval(in Hit hit, in float mediumIOR, in Material mat, in vec3 N, in vec3 V, in vec3 L, inout vec3 bsdf, inout float pdf)
 {
 	bsdf = BLACK;
 	pdf = 1.0;
 
 	vec3 H;
 	bool reflected = dot(N, L) > 0.0;
-	float eta = reflected ? (mat.IOR / Path.mediumIOR[pathid]) : (Path.mediumIOR[pathid] / mat.IOR);
+	float eta = reflected ? (mat.IOR / mediumIOR) : (mediumIOR / mat.IOR);
 
 	if(reflected)
 		H = normalize(L + V);
@@ -263,6 +269,7 @@ void PrincipledEval(in uint tid, in uint pathid, in Material mat, in vec3 N, in
 	float brdfPdf = 1.0;
 	float btdfPdf = 1.0;
 
+#ifdef HAS_TRANSMISSION
 	if(transWeight > 0.0)
 	{
 		if(reflected)
@@ -271,10 +278,11 @@ void PrincipledEval(in uint tid, in uint pathid, in Material mat, in vec3 N, in
 		{
 			btdf = EvalDielectricRefraction(mat, N, V, L, H, btdfPdf, eta);
 
-			float dist = distance(Intersection.point[tid], Intersection.lastPoint[tid]);
+			float dist = distance(hit.point, hit.lastPoint);
 			btdf *= exp(-dist * mat.density);
 		}
 	}
+#endif
 
 	float m_pdf;
 
@@ -286,8 +294,10 @@ void PrincipledEval(in uint tid, in uint pathid, in Material mat, in vec3 N, in
 		brdf += EvalSpecularReflection(mat, N, V, L, H, m_pdf);
 		brdfPdf += m_pdf * primarySpecRatio * (1.0 - diffuseWeight);
 		
+#ifdef HAS_CLEARCOAT
 		brdf += EvalClearCoat(mat, N, V, L, H, m_pdf);
 		brdfPdf += m_pdf * (1.0 - primarySpecRatio) * (1.0 - diffuseWeight);
+#endif
 	}
 
 	bsdf = mix(brdf, btdf, transWeight);
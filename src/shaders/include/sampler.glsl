@@ -0,0 +1,94 @@
+// Owen-scrambled Sobol sampler indexed by (pixel, sample index, dimension).
+// Every dimension draws from its own shuffled and scrambled copy of the first two Sobol dimensions,
+// seeded by the pixel and the dimension, so any number of dimensions stays well stratified
+// (Burley 2020, Practical Hash-based Owen Scrambling).
+
+// Dimension allocation, shared by every kernel that consumes samples
+#define DIM_CAMERA		0	// 2D, pixel jitter
+#define DIM_BOUNCE		2	// First dimension of bounce 0
+#define DIMS_PER_BOUNCE 8
+
+// Offsets from the first dimension of a bounce
+#define DIM_RR			0	// 1D, russian roulette
+#define DIM_LOBE		1	// 1D, BSDF lobe selection
+#define DIM_FRESNEL		2	// 1D, dielectric reflection or refraction
+#define DIM_BSDF		3	// 2D, BSDF direction
+#define DIM_LIGHT		5	// 2D, light sample
+#define DIM_LIGHT_PICK	7	// 1D, light selection
+
+uint Hash(in uint x)
+{
+	x ^= x >> 16u;
+	x *= 0x7feb352du;
+	x ^= x >> 15u;
+	x *= 0x846ca68bu;
+	x ^= x >> 16u;
+	return x;
+}
+
+uint HashCombine(in uint seed, in uint v)
+{
+	return seed ^ (v + (seed << 6u) + (seed >> 2u));
+}
+
+// Nested uniform scramble of a reversed bit pattern, bits only depend on the bits below them
+uint LaineKarrasPermutation(in uint x, in uint seed)
+{
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return x;
+}
+
+uint NestedUniformScramble(in uint x, in uint seed)
+{
+	return bitfieldReverse(LaineKarrasPermutation(bitfieldReverse(x), seed));
+}
+
+// Second Sobol dimension, the first one is the bit reversed index
+uint SobolSecondDimension(in uint index)
+{
+	uint result = 0u;
+	for(uint v = 1u << 31u; index != 0u; index >>= 1u, v ^= v >> 1u)
+		if((index & 1u) != 0u)
+			result ^= v;
+
+	return result;
+}
+
+// Keep 24 bits so the result stays below 1.0 once converted to float
+float ToUnitFloat(in uint x)
+{
+	return float(x >> 8u) * (1.0 / 16777216.0);
+}
+
+void InitSampler(in uint pixel, in uint sampleIndex, in uint dimension)
+{
+	samplerState = uvec3(pixel, sampleIndex, dimension);
+}
+
+void InitBounceSampler(in uint pixel, in uint sampleIndex, in uint depth)
+{
+	InitSampler(pixel, sampleIndex, DIM_BOUNCE + depth * DIMS_PER_BOUNCE);
+}
+
+vec2 Sample2D(in uint offset)
+{
+	uint seed = HashCombine(Hash(samplerState.x), Hash(samplerState.z + offset));
+	uint index = NestedUniformScramble(samplerState.y, seed);
+
+	uint x = NestedUniformScramble(bitfieldReverse(index), HashCombine(seed, 0u));
+	uint y = NestedUniformScramble(SobolSecondDimension(index), HashCombine(seed, 1u));
+
+	return vec2(ToUnitFloat(x), ToUnitFloat(y));
+}
+
+float Sample1D(in uint offset)
+{
+	uint seed = HashCombine(Hash(samplerState.x), Hash(samplerState.z + offset));
+	uint index = NestedUniformScramble(samplerState.y, seed);
+
+	return ToUnitFloat(NestedUniformScramble(bitfieldReverse(index), HashCombine(seed, 0u)));
+}
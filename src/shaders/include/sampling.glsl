@@ -34,10 +34,9 @@ vec3 ImportanceSampleGGX(in vec2 Xi, in float a)
 	return vec3(cos(phi) * sinTheta, cosTheta, sinTheta * sin(phi));
 }
 
-LightSample SampleSphereLight(in SphereLight light, in vec3 surfacePos)
+// Uniform over the hemisphere facing the surface, which holds every point visible from it
+LightSample SampleSphereLight(in SphereLight light, in vec3 surfacePos, in vec2 Xi)
 {
-	vec2 Xi = Rand2();
-
 	vec3 sphereCenterToSurface = normalize(surfacePos - light.worldPos);
 	vec3 sampleDir = SampleHemisphere(Xi);
 	vec3 sampleDirToWorld = ToWorldSpace(sampleDir, sphereCenterToSurface);
@@ -51,8 +50,30 @@ LightSample SampleSphereLight(in SphereLight light, in vec3 surfacePos)
 	LightSample ls;
 	ls.lightDir = normalize(lightDir);
 	ls.emission = light.emittance;
-	ls.pdf = (dist * dist) / (light.area * abs(dot(normal, lightDir)));
-	ls.dist = dist;
+	ls.pdf = (dist * dist) / (0.5 * light.area * abs(dot(normal, ls.lightDir)));
+
+	// Shadow rays test sphere lights too, keep the light's own surface out of the segment. Points on the far
+	// side of the visible cap stay behind the light's front and are occluded by it, as they should be.
+	ls.dist = dist * (1.0 - 1e-3);
+
+	return ls;
+}
+
+// Uniform over the triangle's area, the pdf is converted to solid angle at the surface
+LightSample SampleTriangleLight(in TriangleLight light, in vec3 surfacePos, in vec2 Xi)
+{
+	float su = sqrt(Xi.x);
+	vec3 lightSurfacePos = (1.0 - su) * light.p0 + su * (1.0 - Xi.y) * light.p1 + su * Xi.y * light.p2;
+	vec3 normal = normalize(cross(light.p1 - light.p0, light.p2 - light.p0));
+
+	float dist = distance(lightSurfacePos, surfacePos);
+
+	LightSample ls;
+	ls.lightDir = (lightSurfacePos - surfacePos) / dist;
+	ls.emission = light.emission;
+	ls.pdf = (dist * dist) / (light.area * abs(dot(normal, ls.lightDir)));
+	// Stop short of the triangle so the shadow ray does not report the light itself as an occluder
+	ls.dist = dist * (1.0 - 1e-3);
 
 	return ls;
 }
@@ -67,10 +88,8 @@ float PowerHeuristic(in float pdf1, in float pdf2)
 	return pdf1 * pdf1 / (pdf1 * pdf1 + pdf2 * pdf2);
 }
 
-vec3 EmitterSample(in uint pathid, in uint depth)
+vec3 EmitterSample(in LightSampleRec ls, in uint depth)
 {
-	LightSampleRec ls = Path.lightSampleRec[pathid];
-
 	vec3 Le;
 	if(depth == 0)
 		Le = ls.emission;
@@ -0,0 +1,32 @@
+// Ray statistics, compiled in with RAY_STATS. Traversal tallies the nodes and primitives of the ray it walks,
+// ClosestHit and AnyHit add them to the batch totals. Totals shared by the whole subgroup are summed with
+// subgroupAdd first so a single invocation issues the atomic, when the driver exposes subgroup arithmetic.
+
+#ifdef RAY_STATS
+
+uint statNodes = 0;
+uint statPrimitives = 0;
+
+#define STAT_NODE()			++statNodes
+#define STAT_PRIMITIVE()	++statPrimitives
+
+#ifdef GL_KHR_shader_subgroup_arithmetic
+#define STAT_ADD(counter, value) { uint statSum = subgroupAdd(value); if(subgroupElect()) atomicAdd(counter, statSum); }
+#else
+#define STAT_ADD(counter, value) atomicAdd(counter, value)
+#endif
+
+// Counts one ray and its traversal work, then clears the tallies for the invocation's next ray
+#define STAT_RAY(counter) { STAT_ADD(counter, 1u); STAT_ADD(Stats.nodesVisited, statNodes); STAT_ADD(Stats.primitivesTested, statPrimitives); statNodes = 0; statPrimitives = 0; }
+
+// Path depths differ within a subgroup, so these go straight to the atomic
+#define STAT_ACTIVE_PATH(depth) atomicAdd(Stats.activePaths[min(depth, uint(MAX_DEPTH))], 1u)
+
+#else
+
+#define STAT_NODE()
+#define STAT_PRIMITIVE()
+#define STAT_RAY(counter)
+#define STAT_ACTIVE_PATH(depth)
+
+#endif
\ No newline at end of file
@@ -0,0 +1,449 @@
+// Model BVH traversal for the extend (closest hit) and connect (any hit) kernels.
+// With STACKLESS_TRAVERSAL the flattened preorder BVH is walked through the nodes' escape links: a node
+// whose bounds the ray misses, or a finished leaf, jumps past its subtree. Nothing is kept per thread but
+// the current index, at the cost of visiting children in a fixed order instead of front to back. Clipping
+// the slab test to the closest hit so far keeps that order from costing much.
+
+#ifdef STACKLESS_TRAVERSAL
+
+void ClosestHitModels(in Ray r, inout float tNear, inout HitRecord hit)
+{
+	vec3 invDir = 1.0 / r.dir;
+	float t;
+	vec2 barycentrics;
+
+	for(int i = 0; i < u_nModels; ++i)
+	{
+		int idx = 0;
+		int end = Scene.models[i].bvhnodes[0].escapeOffset;
+
+		while(idx < end)
+		{
+			BVHNode node = Scene.models[i].bvhnodes[idx];
+			STAT_NODE();
+
+			if(!OverlapAABB(node, invDir, r, 0.0, tNear))
+			{
+				idx = node.escapeOffset;
+				continue;
+			}
+
+			// Leaf node
+			if(node.nPrimitives > 0)
+			{
+				for(int j = 0; j < node.nPrimitives; ++j)
+				{
+					Triangle triangle = Scene.models[i].triangles[node.secondChildOffset + j];
+					STAT_PRIMITIVE();
+					if((t = IntersectTriangle(triangle, r, barycentrics)) != INFINITY && t < tNear)
+					{
+						tNear = t;
+						hit.barycentrics = barycentrics;
+						hit.primid = node.secondChildOffset + j;
+						hit.instid = i;
+					}
+				}
+				idx = node.escapeOffset;
+			}
+			// The first child follows its parent
+			else
+				idx = idx + 1;
+		}
+	}
+}
+
+bool AnyHitModels(in Ray r, in float maxDist)
+{
+	vec3 invDir = 1.0 / r.dir;
+
+	for(int i = 0; i < u_nModels; ++i)
+	{
+		int idx = 0;
+		int end = Scene.models[i].bvhnodes[0].escapeOffset;
+
+		while(idx < end)
+		{
+			BVHNode node = Scene.models[i].bvhnodes[idx];
+			STAT_NODE();
+
+			if(!OverlapAABB(node, invDir, r, EPSILON, maxDist))
+			{
+				idx = node.escapeOffset;
+				continue;
+			}
+
+			if(node.nPrimitives > 0)
+			{
+				for(int j = 0; j < node.nPrimitives; ++j)
+				{
+					STAT_PRIMITIVE();
+					float t = IntersectTriangle(Scene.models[i].triangles[node.secondChildOffset + j], r);
+					if(t > EPSILON && t < maxDist)
+						return true;
+				}
+				idx = node.escapeOffset;
+			}
+			else
+				idx = idx + 1;
+		}
+	}
+
+	return false;
+}
+
+#else
+
+void ClosestHitModels(in Ray r, inout float tNear, inout HitRecord hit)
+{
+	vec3 invDir = 1.0 / r.dir;
+	float t;
+	vec2 barycentrics;
+
+	int stack[64];
+	int ptr = 0;
+
+	for(int i = 0; i < u_nModels; ++i)
+	{
+		// Null node
+		stack[ptr++] = -1;
+
+		// Stack the root node
+		stack[ptr] = 0;
+
+		do
+		{
+			int idx = stack[ptr--];
+			BVHNode node = Scene.models[i].bvhnodes[idx];
+			STAT_NODE();
+
+			// Leaf node
+			if(node.nPrimitives > 0)
+			{
+				// Intersect with primitives (triangles, in this case)
+				for(int j = 0; j < node.nPrimitives; ++j)
+				{
+					Triangle triangle = Scene.models[i].triangles[node.secondChildOffset + j];
+					STAT_PRIMITIVE();
+					if((t = IntersectTriangle(triangle, r, barycentrics)) != INFINITY && t < tNear)
+					{
+						tNear = t;
+						hit.barycentrics = barycentrics;
+						hit.primid = node.secondChildOffset + j;
+						hit.instid = i;
+					}
+				}
+			}
+			else
+			{
+				BVHNode leftChild  = Scene.models[i].bvhnodes[idx + 1];
+				BVHNode rightChild = Scene.models[i].bvhnodes[node.secondChildOffset];
+
+				float tLeft	 = IntersectAABB(leftChild, invDir, r);
+				float tRight = IntersectAABB(rightChild, invDir, r);
+
+				if(tLeft > 0.0 && tRight > 0.0)
+				{
+					if(tLeft < tRight)
+					{
+						stack[++ptr] = node.secondChildOffset;
+						stack[++ptr] = idx + 1;
+					}
+					else
+					{
+						stack[++ptr] = idx + 1;
+						stack[++ptr] = node.secondChildOffset;
+					}
+				}
+				else if(tLeft > 0.0)
+					stack[++ptr] = idx + 1;
+				else if(tRight > 0.0)
+					stack[++ptr] = node.secondChildOffset;
+			}
+		} while(ptr > 0);
+	}
+}
+
+bool AnyHitModels(in Ray r, in float maxDist)
+{
+	vec3 invDir = 1.0 / r.dir;
+	int stack[64];
+	int ptr;
+
+	for(int i = 0; i < u_nModels; ++i)
+	{
+		// Skip models whose bounds the segment misses
+		if(!OverlapAABB(Scene.models[i].bvhnodes[0], invDir, r, EPSILON, maxDist))
+			continue;
+
+		// Null node and root
+		ptr = 0;
+		stack[ptr++] = -1;
+		stack[ptr] = 0;
+
+		do
+		{
+			int idx = stack[ptr--];
+			BVHNode node = Scene.models[i].bvhnodes[idx];
+			STAT_NODE();
+
+			// Leaf node
+			if(node.nPrimitives > 0)
+			{
+				for(int j = 0; j < node.nPrimitives; ++j)
+				{
+					STAT_PRIMITIVE();
+					float t = IntersectTriangle(Scene.models[i].triangles[node.secondChildOffset + j], r);
+					if(t > EPSILON && t < maxDist)
+						return true;
+				}
+			}
+			else
+			{
+				if(OverlapAABB(Scene.models[i].bvhnodes[idx + 1], invDir, r, EPSILON, maxDist))
+					stack[++ptr] = idx + 1;
+				if(OverlapAABB(Scene.models[i].bvhnodes[node.secondChildOffset], invDir, r, EPSILON, maxDist))
+					stack[++ptr] = node.secondChildOffset;
+			}
+		} while(ptr > 0);
+	}
+
+	return false;
+}
+
+#endif
+
+#ifdef REFERENCE_OCCLUSION
+
+// The walk shadow rays shared with the closest hit before they got their own: children ordered front to back
+// by unclipped slab tests, nothing culled past the light and no early out on a model's root bounds. Only built
+// into the shadow benchmark's reference connect kernel.
+bool AnyHitModelsReference(in Ray r, in float maxDist)
+{
+	vec3 invDir = 1.0 / r.dir;
+	int stack[64];
+	int ptr = 0;
+
+	for(int i = 0; i < u_nModels; ++i)
+	{
+		// Null node
+		stack[ptr++] = -1;
+
+		// Stack the root node
+		stack[ptr] = 0;
+
+		do
+		{
+			int idx = stack[ptr--];
+			BVHNode node = Scene.models[i].bvhnodes[idx];
+			STAT_NODE();
+
+			// Leaf node
+			if(node.nPrimitives > 0)
+			{
+				for(int j = 0; j < node.nPrimitives; ++j)
+				{
+					STAT_PRIMITIVE();
+					float t = IntersectTriangle(Scene.models[i].triangles[node.secondChildOffset + j], r);
+					if(t > EPSILON && t < maxDist)
+						return true;
+				}
+			}
+			else
+			{
+				float tLeft	 = IntersectAABB(Scene.models[i].bvhnodes[idx + 1], invDir, r);
+				float tRight = IntersectAABB(Scene.models[i].bvhnodes[node.secondChildOffset], invDir, r);
+
+				if(tLeft > 0.0 && tRight > 0.0)
+				{
+					if(tLeft < tRight)
+					{
+						stack[++ptr] = node.secondChildOffset;
+						stack[++ptr] = idx + 1;
+					}
+					else
+					{
+						stack[++ptr] = idx + 1;
+						stack[++ptr] = node.secondChildOffset;
+					}
+				}
+				else if(tLeft > 0.0)
+					stack[++ptr] = idx + 1;
+				else if(tRight > 0.0)
+					stack[++ptr] = node.secondChildOffset;
+			}
+		} while(ptr > 0);
+	}
+
+	return false;
+}
+
+#endif
+
+// Spheres and sphere lights share one small BVH whose leaves hold type tagged references. It is always
+// walked through escape links, its trees are shallow enough that ordering the children buys little.
+Sphere AnalyticSphere(in uint type, in uint index)
+{
+	if(type == PRIMITIVE_SPHERE)
+		return Spheres.sphere[index];
+
+	Sphere s;
+	s.worldPos = SphereLights.sphereLight[index].worldPos;
+	s.radius = SphereLights.sphereLight[index].radius;
+	return s;
+}
+
+void ClosestHitAnalytic(in Ray r, inout float tNear, inout HitRecord hit)
+{
+	if(u_nSpheres + u_nSphereLights == 0)
+		return;
+
+	vec3 invDir = 1.0 / r.dir;
+	int idx = 0;
+	int end = AnalyticBVH.node[0].escapeOffset;
+
+	while(idx < end)
+	{
+		BVHNode node = AnalyticBVH.node[idx];
+		STAT_NODE();
+
+		if(!OverlapAABB(node, invDir, r, 0.0, tNear))
+		{
+			idx = node.escapeOffset;
+			continue;
+		}
+
+		if(node.nPrimitives > 0)
+		{
+			for(int j = 0; j < node.nPrimitives; ++j)
+			{
+				uint ref = AnalyticPrimitives.ref[node.secondChildOffset + j];
+				uint type = ref >> PRIMITIVE_TYPE_SHIFT;
+				uint index = ref & PRIMITIVE_INDEX_MASK;
+
+				STAT_PRIMITIVE();
+				float t = IntersectSphere(AnalyticSphere(type, index), r);
+				if(t != INFINITY && t < tNear)
+				{
+					tNear = t;
+					hit.primid = index;
+					hit.instid = type == PRIMITIVE_SPHERE ? INSTANCE_SPHERE : INSTANCE_SPHERE_LIGHT;
+				}
+			}
+			idx = node.escapeOffset;
+		}
+		else
+			idx = idx + 1;
+	}
+}
+
+// Sphere lights block shadow rays like spheres do, the segment toward a sampled light ends just short of it
+bool AnyHitAnalytic(in Ray r, in float maxDist)
+{
+	if(u_nSpheres + u_nSphereLights == 0)
+		return false;
+
+	vec3 invDir = 1.0 / r.dir;
+	int idx = 0;
+	int end = AnalyticBVH.node[0].escapeOffset;
+
+	while(idx < end)
+	{
+		BVHNode node = AnalyticBVH.node[idx];
+		STAT_NODE();
+
+		if(!OverlapAABB(node, invDir, r, EPSILON, maxDist))
+		{
+			idx = node.escapeOffset;
+			continue;
+		}
+
+		if(node.nPrimitives > 0)
+		{
+			for(int j = 0; j < node.nPrimitives; ++j)
+			{
+				uint ref = AnalyticPrimitives.ref[node.secondChildOffset + j];
+
+				STAT_PRIMITIVE();
+				// Shadow rays are normalized so t is the distance, rebuilding it from the hit point loses precision far away
+				if(IntersectSphere(AnalyticSphere(ref >> PRIMITIVE_TYPE_SHIFT, ref & PRIMITIVE_INDEX_MASK), r) < maxDist)
+					return true;
+			}
+			idx = node.escapeOffset;
+		}
+		else
+			idx = idx + 1;
+	}
+
+	return false;
+}
+
+HitRecord ClosestHit(in Ray r)
+{
+	HitRecord hit;
+	hit.t			 = INFINITY;
+	hit.barycentrics = vec2(0.0);
+	hit.primid		 = 0;
+	hit.instid		 = 0;
+
+	float tNear = INFINITY;
+
+#if defined(HAS_SPHERES) || defined(HAS_SPHERE_LIGHTS)
+	ClosestHitAnalytic(r, tNear, hit);
+#endif
+#ifdef HAS_MODELS
+	ClosestHitModels(r, tNear, hit);
+#endif
+	STAT_RAY(Stats.extendRays);
+
+	hit.t = tNear;
+	return hit;
+}
+
+// Occlusion query for shadow rays, it stops at the first blocker in (EPSILON, maxDist). Geometry the scene
+// does not have is compiled out through its HAS_* define.
+bool AnyHit(in Ray r, in float maxDist)
+{
+	bool occluded = false;
+#if defined(HAS_SPHERES) || defined(HAS_SPHERE_LIGHTS)
+	occluded = AnyHitAnalytic(r, maxDist);
+#endif
+#if defined(HAS_MODELS) && defined(REFERENCE_OCCLUSION)
+	occluded = occluded || AnyHitModelsReference(r, maxDist);
+#elif defined(HAS_MODELS)
+	occluded = occluded || AnyHitModels(r, maxDist);
+#endif
+	STAT_RAY(Stats.shadowRays);
+
+	return occluded;
+}
+
+// Trace the idx-th extension ray and enqueue its hit for the shade kernel
+void TraceExtendRay(in uint idx)
+{
+	uint nthreads = atomicAdd(Atomic.shadeThreadCounter, 1);
+	if(nthreads % MIN_WORK_GROUP_INVOCATION_X == 0)
+		atomicAdd(Atomic.shadeWorkGroup, 1);
+
+	Ray extendRay = ExtQueue.extendRay[in_offset + idx];
+	HitRecord hit = ClosestHit(extendRay);
+
+	// Enqueue results, the shade kernel rebuilds the shading data from them
+	Intersection.t[idx] = hit.t;
+
+	if(hit.t == INFINITY)
+		return;
+	
+	Intersection.barycentrics[idx] = hit.barycentrics;
+	Intersection.primid[idx]	   = hit.primid;
+	Intersection.instid[idx]	   = hit.instid;
+}
+
+// Trace the idx-th shadow ray and drop its path's light sample when it is blocked
+void TraceShadowRay(in uint idx)
+{
+	Ray shadowRay = ShadowQueue.shadowRay[idx];
+	float dist = Path.lightSampleRec[shadowRay.pathid].dist;
+	
+	if(AnyHit(shadowRay, dist))
+		Path.lightSampleRec[shadowRay.pathid].bsdfEval = vec3(0.0f, 0.0f, 0.0f);
+}
@@ -0,0 +1,191 @@
+#version 430 core
+#include "include/globals.glsl"
+#include "include/utils.glsl"
+#include "include/sampler.glsl"
+#include "include/buffers.glsl"
+#include "include/stats.glsl"
+#include "include/sampling.glsl"
+#include "include/intersect.glsl"
+#include "include/traversal.glsl"
+#include "include/principled.glsl"
+#include "include/camera.glsl"
+#include "include/environment.glsl"
+#include "include/lights.glsl"
+
+layout(local_size_x = MIN_WORK_GROUP_INVOCATION_X) in;
+
+// Whole paths in one invocation: the same estimator as generate, extend, shade and connect, with the path
+// state kept in registers instead of the wavefront queues. The radiance lands in Path.radiance so the image
+// kernel resolves both modes alike. Both shade vertices 0 to MAX_DEPTH, the wavefront pipeline over MAX_DEPTH + 1
+// iterations, so switching modes mid-accumulation keeps converging to the same image.
+
+Hit FetchHit(in HitRecord record, in Ray r, inout LightSampleRec rec)
+{
+	Hit hit;
+	hit.point	  = vec3(INFINITY);
+	hit.N		  = vec3(0.0);
+	hit.t		  = record.t;
+	hit.matid	  = 0;
+	hit.emitter	  = false;
+
+	hit.lastPoint = r.origin;
+	hit.V = normalize(-r.dir);
+
+	if(hit.t == INFINITY)
+		return hit;
+
+	if(record.instid == INSTANCE_SPHERE)
+		FetchSphereData(Spheres.sphere[record.primid], hit.t, r, hit);
+	else if(record.instid == INSTANCE_SPHERE_LIGHT)
+	{
+		FetchSphereLightData(SphereLights.sphereLight[record.primid], hit.t, r, hit, rec);
+		rec.lightPdf *= (1.0 - EnvironmentSelectPdf()) * LightPmf(r.origin, record.primid);
+	}
+	else
+	{
+		FetchTriangleData(Scene.models[record.instid].triangles[record.primid], Scene.models[record.instid].matid, hit.t, record.barycentrics, r, hit);
+
+#ifdef HAS_TRIANGLE_LIGHTS
+		uint lightOffset = Scene.models[record.instid].lightOffset;
+		if(lightOffset != NO_LIGHT)
+		{
+			FetchTriangleLightData(TriangleLights.triangleLight[lightOffset + record.primid], r, hit, rec);
+			rec.lightPdf *= (1.0 - EnvironmentSelectPdf()) * LightPmf(r.origin, u_nSphereLights + lightOffset + record.primid);
+		}
+#endif
+	}
+
+	return hit;
+}
+
+vec3 TracePath(in Ray r, in uint pixel, in uint sampleIdx)
+{
+	vec3 throughput = vec3(1.0);
+	vec3 radiance = vec3(0.0);
+	float mediumIOR = 1.0;
+
+	LightSampleRec rec;
+	rec.bsdfEval = BLACK;
+	rec.emission = BLACK;
+	rec.bsdfPdf	 = 0.0;
+	rec.lightPdf = 0.0;
+
+	for(uint depth = 0; ; ++depth)
+	{
+		InitBounceSampler(pixel, u_sampleBase + sampleIdx, depth);
+		STAT_ACTIVE_PATH(depth);
+
+		Hit hit = FetchHit(ClosestHit(r), r, rec);
+
+		// Hit background
+		if(hit.t == INFINITY)
+		{
+			if(u_environment)
+			{
+				vec3 dir = normalize(-hit.V);
+				vec3 Le = EnvironmentRadiance(dir);
+				if(depth > 0)
+					Le *= PowerHeuristic(rec.bsdfPdf, EnvironmentPdf(dir) * EnvironmentSelectPdf());
+
+				radiance += throughput * Le;
+			}
+			break;
+		}
+		// Hit a light
+		if(hit.emitter)
+		{
+			radiance += EmitterSample(rec, depth) * throughput;
+			break;
+		}
+		if(depth >= MAX_DEPTH)
+			break;
+		// Russian roullete elimination
+		if(depth >= RR_MAX_DEPTH)
+		{
+			float p = max(throughput.x, max(throughput.y, throughput.z));
+			if(Sample1D(DIM_RR) > p)
+				break;
+
+			throughput /= p;
+		}
+
+		Material mat = Scene.material[hit.matid];
+
+		vec3 L, H;
+		vec3 N = hit.N;
+		vec3 V = hit.V;
+
+		vec3 bsdf = BLACK;
+		float bsdfPdf = 1.0;
+
+		vec3 vertexThroughput = throughput;
+
+		PrincipledSample(hit, mediumIOR, mat, N, V, L, H, bsdf, bsdfPdf);
+		throughput *= abs(dot(N, L)) * bsdf / bsdfPdf;
+		rec.bsdfPdf = bsdfPdf;
+
+		// Next event estimation, the environment or a light picked by the light sampler
+		LightSample ls;
+		ls.pdf = 0.0;
+		float pick = Sample1D(DIM_LIGHT_PICK);
+		float envSelectPdf = EnvironmentSelectPdf();
+		if(pick < envSelectPdf)
+		{
+			ls = SampleEnvironment(Sample2D(DIM_LIGHT));
+			ls.pdf *= envSelectPdf;
+		}
+		else if(u_nLights > 0)
+		{
+			float lightPmf;
+			uint lightIdx = SampleLight(hit.point, min((pick - envSelectPdf) / (1.0 - envSelectPdf), 0.99999994), lightPmf);
+			if(lightPmf > 0.0)
+			{
+				ls = SampleLightSource(lightIdx, hit.point, Sample2D(DIM_LIGHT));
+				ls.pdf *= (1.0 - envSelectPdf) * lightPmf;
+			}
+		}
+
+		if(ls.pdf > 0.0)
+		{
+			Ray sr;
+			sr.origin = hit.point + N * EPSILON;
+			sr.dir = ls.lightDir;
+			sr.pathid = r.pathid;
+
+			if(!AnyHit(sr, ls.dist - EPSILON))
+			{
+				vec3 lightBsdf;
+				float lightBsdfPdf;
+				PrincipledEval(hit, mediumIOR, mat, N, V, ls.lightDir, lightBsdf, lightBsdfPdf);
+				radiance += vertexThroughput * PowerHeuristic(ls.pdf, lightBsdfPdf) * ls.emission * abs(dot(N, ls.lightDir)) * lightBsdf / ls.pdf;
+			}
+		}
+
+		// Extend the path
+		r.origin = hit.point + N * EPSILON;
+		r.dir = L;
+	}
+
+	return radiance;
+}
+
+void main()
+{
+	uint tid = gl_GlobalInvocationID.x;
+
+	if(tid >= u_tileSize)
+		return;
+
+	// Same mapping as the generate kernel, u_samplesPerPixel consecutive paths per active pixel of the tile
+	uint activeIdx = u_tileOffset + tid / u_samplesPerPixel;
+	uint sampleIdx = tid % u_samplesPerPixel;
+	if(activeIdx >= Active.count)
+		return;
+
+	uint pixel = Active.pixel[activeIdx];
+
+	InitSampler(pixel, u_sampleBase + sampleIdx, DIM_CAMERA);
+	Ray r = GeneratePrimaryRay(tid, pixel);
+
+	Path.radiance[tid] = TracePath(r, pixel, sampleIdx);
+}
\ No newline at end of file
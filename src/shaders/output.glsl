@@ -31,9 +31,17 @@ void main() {
 out vec4 color;
 in vec2 texCoords;
 
-uniform sampler2D outputTex;
+// Tone mapping runs at presentation so the compute batches only ever touch the accumulator
+uniform sampler2D accumulatorTex;
+
+void ReinhardToneMapping(inout vec4 pixelColor)
+{
+	pixelColor /= pixelColor.w;
+	pixelColor = sqrt(pixelColor / (pixelColor + vec4(1.0)));
+}
 
 void main() { 
-    color = texture(outputTex, texCoords);
+    color = texture(accumulatorTex, texCoords);
+    ReinhardToneMapping(color);
 }
 #endif
@@ -1,14 +1,19 @@
 #version 430 core
 #include "include/globals.glsl"
 #include "include/utils.glsl"
+#include "include/sampler.glsl"
 #include "include/buffers.glsl"
+#include "include/stats.glsl"
 #include "include/sampling.glsl"
+#include "include/intersect.glsl"
 #include "include/principled.glsl"
+#include "include/camera.glsl"
+#include "include/environment.glsl"
+#include "include/lights.glsl"
 
 layout(local_size_x = MIN_WORK_GROUP_INVOCATION_X) in;
 
-uniform sampler2D u_HDRI;
-uniform uint u_depth;
+uniform bool u_regenerate;
 
 void GenerateExtendRay(in vec3 N, in vec3 L, in vec3 rayOrigin, in uint pathid, in uint nthreads)
 {
@@ -18,7 +23,10 @@ void GenerateExtendRay(in vec3 N, in vec3 L, in vec3 rayOrigin, in uint pathid,
 	r.pathid = pathid;
 	
 	if(nthreads % MIN_WORK_GROUP_INVOCATION_X == 0)
+	{
 		atomicAdd(Atomic.extendWorkGroup, 1);
+		atomicAdd(Atomic.traceWorkGroup, 1);
+	}
 
 	ExtQueue.extendRay[out_offset + nthreads] = r;
 }
@@ -31,36 +39,91 @@ void GenerateShadowRay(in vec3 N, in vec3 L, in vec3 rayOrigin, in uint pathid,
 	sr.pathid = pathid;
 	
 	if(nthreads % MIN_WORK_GROUP_INVOCATION_X == 0)
+	{
 		atomicAdd(Atomic.connectWorkGroup, 1);
+		atomicAdd(Atomic.traceWorkGroup, 1);
+	}
 
 	ShadowQueue.shadowRay[nthreads] = sr;
 }
 
-bool PathTerminated(in uint pathid)
+// Rebuild the shading data from the compact hit record of the extend kernel
+Hit FetchHit(in uint tid, in Ray r)
 {
-	uint tid = gl_GlobalInvocationID.x;
+	Hit hit;
+	hit.point	  = vec3(INFINITY);
+	hit.N		  = vec3(0.0);
+	hit.t		  = Intersection.t[tid];
+	hit.matid	  = 0;
+	hit.emitter	  = false;
+
+	hit.lastPoint = r.origin;
+	hit.V = normalize(-r.dir);
+
+	if(hit.t == INFINITY)
+		return hit;
+
+	uint primid = Intersection.primid[tid];
+	uint instid = Intersection.instid[tid];
 
-	// Hit background
-	if(Intersection.t[tid] == INFINITY)
+	if(instid == INSTANCE_SPHERE)
+		FetchSphereData(Spheres.sphere[primid], hit.t, r, hit);
+	else if(instid == INSTANCE_SPHERE_LIGHT)
 	{
-		// TODO: MIS Env Map
-		float exposure = 3.0;
-		vec3 dir = normalize(-Intersection.V[tid]);
-		vec2 uv = vec2((PI + atan(dir.z, dir.x)) * (1.0 / (TWO_PI)), acos(-dir.y) * (1.0 / PI));
-		Path.radiance[pathid] += Path.throughput[pathid] * exposure * texture(u_HDRI, uv).xyz;
-		//Path.radiance[pathid] += Path.throughput[pathid] * vec3(0.0);
+		// The light could also have been picked for next event estimation from the ray origin
+		FetchSphereLightData(SphereLights.sphereLight[primid], hit.t, r, hit, Path.lightSampleRec[r.pathid]);
+		Path.lightSampleRec[r.pathid].lightPdf *= (1.0 - EnvironmentSelectPdf()) * LightPmf(r.origin, primid);
+	}
+	else
+	{
+		FetchTriangleData(Scene.models[instid].triangles[primid], Scene.models[instid].matid, hit.t, Intersection.barycentrics[tid], r, hit);
+
+		// Triangles of emissive meshes are area lights, light indices follow the sphere lights
+#ifdef HAS_TRIANGLE_LIGHTS
+		uint lightOffset = Scene.models[instid].lightOffset;
+		if(lightOffset != NO_LIGHT)
+		{
+			FetchTriangleLightData(TriangleLights.triangleLight[lightOffset + primid], r, hit, Path.lightSampleRec[r.pathid]);
+			Path.lightSampleRec[r.pathid].lightPdf *= (1.0 - EnvironmentSelectPdf()) * LightPmf(r.origin, u_nSphereLights + lightOffset + primid);
+		}
+#endif
+	}
+
+	return hit;
+}
+
+bool PathTerminated(in Hit hit, in uint pathid, in uint depth)
+{
+	// Hit background, BSDF sampled directions are weighted against next event estimation toward the environment
+	if(hit.t == INFINITY)
+	{
+		if(u_environment)
+		{
+			vec3 dir = normalize(-hit.V);
+			vec3 Le = EnvironmentRadiance(dir);
+			if(depth > 0)
+				Le *= PowerHeuristic(Path.lightSampleRec[pathid].bsdfPdf, EnvironmentPdf(dir) * EnvironmentSelectPdf());
+
+			Path.radiance[pathid] += Path.throughput[pathid] * Le;
+		}
 		return true;
 	}
 	// Hit a light
-	else if(Intersection.emitter[tid] == true)
+	else if(hit.emitter == true)
+	{
+		Path.radiance[pathid] += EmitterSample(Path.lightSampleRec[pathid], depth) * Path.throughput[pathid];
+		return true;
+	}
+	// Reached max depth
+	else if(depth >= MAX_DEPTH)
 	{
-		Path.radiance[pathid] += EmitterSample(pathid, u_depth) * Path.throughput[pathid];
+		Path.throughput[pathid] = BLACK;
 		return true;
 	}
 	// Russian roullete elimination
-	else if(u_depth >= RR_MAX_DEPTH)
+	else if(depth >= RR_MAX_DEPTH)
 	{
-		float Xi = Rand();
+		float Xi = Sample1D(DIM_RR);
 		float p = max(Path.throughput[pathid].x, max(Path.throughput[pathid].y, Path.throughput[pathid].z));
 	
 		if(Xi > p)
@@ -68,16 +131,62 @@ bool PathTerminated(in uint pathid)
 	
 		Path.throughput[pathid] /= p;
 	}
-	// Reached max depth
-	else if(u_depth >= MAX_DEPTH)
-	{
-		Path.throughput[pathid] = BLACK;
-		return true;
-	}
 	
 	return false;
 }
 
+// Float addition on the splat buffer through a compare and swap loop
+void AtomicAddFloat(in uint idx, in float value)
+{
+	uint expected = Splat.splat[idx];
+	uint assumed;
+
+	do
+	{
+		assumed = expected;
+		expected = atomicCompSwap(Splat.splat[idx], assumed, floatBitsToUint(uintBitsToFloat(assumed) + value));
+	} while(expected != assumed);
+}
+
+// Add a finished path's radiance to its pixel, samples of the same pixel may finish concurrently
+void SplatPath(in uint pathid)
+{
+	uint idx = Path.pixel[pathid] * 5;
+	vec3 radiance = Path.radiance[pathid];
+
+	highp bvec3 nan = isnan(radiance);
+	highp bvec3 inf = isinf(radiance);
+	if(!(nan.x || nan.y || nan.z || inf.x || inf.y || inf.z))
+	{
+		float luminance = Luminance(radiance);
+		AtomicAddFloat(idx + 0, radiance.x);
+		AtomicAddFloat(idx + 1, radiance.y);
+		AtomicAddFloat(idx + 2, radiance.z);
+		AtomicAddFloat(idx + 3, luminance * luminance);
+	}
+
+	atomicAdd(Splat.splat[idx + 4], 1);
+}
+
+// Refill a finished path's slot with the next pending camera sample of the frame
+void RegeneratePath(in uint pathid)
+{
+	uint poolIdx = atomicAdd(Atomic.sampleCounter, 1);
+	if(poolIdx >= Active.count * u_samplesPerPixel)
+		return;
+
+	// Consecutive pool samples go to different pixels to keep the splats uncontended
+	uint pixel = Active.pixel[poolIdx % Active.count];
+	uint sampleIdx = poolIdx / Active.count;
+
+	StartPathState(pathid, pixel, sampleIdx);
+	InitSampler(pixel, u_sampleBase + sampleIdx, DIM_CAMERA);
+	Ray r = GeneratePrimaryRay(pathid, pixel);
+
+	uint nthreads = atomicAdd(Atomic.extendThreadCounter, 1);
+	GenerateExtendRay(vec3(0.0), r.dir, r.origin, pathid, nthreads);
+}
+
 void main()
 {
 	uint tid = gl_GlobalInvocationID.x;
@@ -85,45 +194,82 @@ void main()
 	if(tid >= Atomic.shadeThreadCounter)
 		return;
 
-	SetSeed(gl_GlobalInvocationID.xy, u_frame);
+	Ray r = ExtQueue.extendRay[in_offset + tid];
+	uint pathid = r.pathid;
+	uint depth = Path.depth[pathid];
+	STAT_ACTIVE_PATH(depth);
 
-	uint pathid = ExtQueue.extendRay[in_offset + tid].pathid;
+	InitBounceSampler(Path.pixel[pathid], u_sampleBase + Path.sampleIdx[pathid], depth);
 
-	// Direct lighting contribution
-	Path.radiance[pathid] += Path.lightSampleRec[pathid].bsdfEval * Path.throughput[pathid];
+	// Direct lighting contribution, already weighted by the throughput of the vertex it was sampled from
+	Path.radiance[pathid] += Path.lightSampleRec[pathid].bsdfEval;
 	
-	if(PathTerminated(pathid))
+	Hit hit = FetchHit(tid, r);
+
+	if(PathTerminated(hit, pathid, depth))
+	{
+		if(u_regenerate)
+		{
+			SplatPath(pathid);
+			RegeneratePath(pathid);
+		}
 		return;
+	}
 	
-	uint matid = Intersection.matid[tid];
-	Material mat = Scene.material[matid];
+	Material mat = Scene.material[hit.matid];
 
 	vec3 L, H;
-	vec3 N = Intersection.N[tid];
-	vec3 V = Intersection.V[tid];
+	vec3 N = hit.N;
+	vec3 V = hit.V;
 	
 	vec3 bsdf = BLACK;
 	float bsdfPdf = 1.0;
 
+	// Next event estimation is weighted by the throughput before this vertex's BSDF sample
+	vec3 throughput = Path.throughput[pathid];
+
 	// Indirect lighting evaluation
-	PrincipledSample(tid, pathid, mat, N, V, L, H, bsdf, bsdfPdf);
+	PrincipledSample(hit, Path.mediumIOR[pathid], mat, N, V, L, H, bsdf, bsdfPdf);
 	Path.throughput[pathid] *= abs(dot(N, L)) * bsdf / bsdfPdf;
 
 	// Indirect lighting BSDF pdf for the next iteration MIS
 	Path.lightSampleRec[pathid].bsdfPdf = bsdfPdf;
 	
 	// Extend this path for the next iteration
+	Path.depth[pathid] = depth + 1;
 	uint nthreads = atomicAdd(Atomic.extendThreadCounter, 1);
-	GenerateExtendRay(N, L, Intersection.point[tid], pathid, nthreads);
+	GenerateExtendRay(N, L, hit.point, pathid, nthreads);
 
-	// Generate light sample (TODO: change to random light)
-	LightSample ls = SampleSphereLight(Scene.sphereLight[0], Intersection.point[tid]);
+	// Next event estimation, the environment or a light picked by the light sampler
+	LightSample ls;
+	ls.pdf = 0.0;
+	float pick = Sample1D(DIM_LIGHT_PICK);
+	float envSelectPdf = EnvironmentSelectPdf();
+	if(pick < envSelectPdf)
+	{
+		ls = SampleEnvironment(Sample2D(DIM_LIGHT));
+		ls.pdf *= envSelectPdf;
+	}
+	else if(u_nLights > 0)
+	{
+		float lightPmf;
+		uint lightIdx = SampleLight(hit.point, min((pick - envSelectPdf) / (1.0 - envSelectPdf), 0.99999994), lightPmf);
+		if(lightPmf > 0.0)
+		{
+			ls = SampleLightSource(lightIdx, hit.point, Sample2D(DIM_LIGHT));
+			ls.pdf *= (1.0 - envSelectPdf) * lightPmf;
+		}
+	}
+
+	Path.lightSampleRec[pathid].bsdfEval = BLACK;
+	if(ls.pdf <= 0.0)
+		return;
 	
-	PrincipledEval(tid, pathid, mat, N, V, ls.lightDir, bsdf, bsdfPdf);
-	Path.lightSampleRec[pathid].bsdfEval = PowerHeuristic(ls.pdf, bsdfPdf) * ls.emission * abs(dot(N, ls.lightDir)) * bsdf / ls.pdf;
+	PrincipledEval(hit, Path.mediumIOR[pathid], mat, N, V, ls.lightDir, bsdf, bsdfPdf);
+	Path.lightSampleRec[pathid].bsdfEval = throughput * PowerHeuristic(ls.pdf, bsdfPdf) * ls.emission * abs(dot(N, ls.lightDir)) * bsdf / ls.pdf;
 	Path.lightSampleRec[pathid].dist = ls.dist - EPSILON;
 	
-	// Generate shadow ray
-	atomicAdd(Atomic.connectThreadCounter, 1);
-	GenerateShadowRay(N, ls.lightDir, Intersection.point[tid], pathid, nthreads);
+	// Generate shadow ray, regenerated paths enqueue extension rays only so the shadow queue keeps its own count
+	uint nshadows = atomicAdd(Atomic.connectThreadCounter, 1);
+	GenerateShadowRay(N, ls.lightDir, hit.point, pathid, nshadows);
 }
\ No newline at end of file
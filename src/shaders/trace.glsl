@@ -0,0 +1,21 @@
+#version 430 core
+#include "include/globals.glsl"
+#include "include/buffers.glsl"
+#include "include/stats.glsl"
+#include "include/intersect.glsl"
+#include "include/traversal.glsl"
+
+layout(local_size_x = MIN_WORK_GROUP_INVOCATION_X) in;
+
+// Fused extend and connect: the extension queue and the shadow queue are read as one queue, extension
+// rays first. Each ray's position in it says whether it wants the closest hit or any hit.
+void main()
+{
+	uint tid = gl_GlobalInvocationID.x;
+	uint nExtend = Atomic.extendThreadCounter;
+
+	if(tid < nExtend)
+		TraceExtendRay(tid);
+	else if(tid - nExtend < Atomic.connectThreadCounter)
+		TraceShadowRay(tid - nExtend);
+}
\ No newline at end of file
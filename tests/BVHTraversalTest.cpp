@@ -0,0 +1,392 @@
+#include <PT.h>
+#include <random>
+#include "BVH.h"
+#include "Check.h"
+
+// CPU ports of the model walks in traversal.glsl and of the tests they use from intersect.glsl, run over BVHs
+// from the renderer's own builder. Both the stack and the stackless walks must find the same hits as testing
+// every triangle.
+namespace
+{
+	using namespace PT;
+
+	constexpr float EPSILON = 0.00001f;
+	constexpr float NO_HIT	= 1000000.0f;
+
+	using Triangle = std::array<glm::vec3, 3>;
+
+	struct Ray
+	{
+		glm::vec3 origin;
+		glm::vec3 dir;
+	};
+
+	// Triangles in the order the leaves reference them, like GPUModel
+	struct Model
+	{
+		std::vector<GPUBVHNode> nodes;
+		std::vector<Triangle> triangles;
+	};
+
+	float IntersectTriangle(const Triangle& triangle, const Ray& r)
+	{
+		glm::vec3 v0v1 = triangle[1] - triangle[0];
+		glm::vec3 v0v2 = triangle[2] - triangle[0];
+
+		glm::vec3 pvec = glm::cross(r.dir, v0v2);
+		float det = glm::dot(v0v1, pvec);
+		if (std::abs(det) < EPSILON)
+			return NO_HIT;
+
+		float invDet = 1.0f / det;
+		glm::vec3 tvec = r.origin - triangle[0];
+		float u = glm::dot(tvec, pvec) * invDet;
+		if (u < 0.0f || u > 1.0f)
+			return NO_HIT;
+
+		glm::vec3 qvec = glm::cross(tvec, v0v1);
+		float v = glm::dot(r.dir, qvec) * invDet;
+		if (v < 0.0f || u + v > 1.0f)
+			return NO_HIT;
+
+		float t = glm::dot(v0v2, qvec) * invDet;
+		return t < 0.0f ? NO_HIT : t;
+	}
+
+	float IntersectAABB(const GPUBVHNode& node, const glm::vec3& invDir, const Ray& r)
+	{
+		glm::vec3 tmin = glm::min((node.boundMax - r.origin) * invDir, (node.boundMin - r.origin) * invDir);
+		glm::vec3 tmax = glm::max((node.boundMax - r.origin) * invDir, (node.boundMin - r.origin) * invDir);
+
+		float tNear = std::max(tmin.x, std::max(tmin.y, tmin.z));
+		float tFar = std::min(tmax.x, std::min(tmax.y, tmax.z));
+
+		return (tFar >= tNear) ? (tNear > 0.0f ? tNear : tFar) : -1.0f;
+	}
+
+	bool OverlapAABB(const GPUBVHNode& node, const glm::vec3& invDir, const Ray& r, const float& tMin, const float& tMax)
+	{
+		glm::vec3 tmin = glm::min((node.boundMax - r.origin) * invDir, (node.boundMin - r.origin) * invDir);
+		glm::vec3 tmax = glm::max((node.boundMax - r.origin) * invDir, (node.boundMin - r.origin) * invDir);
+
+		float tNear = std::max(tMin, std::max(tmin.x, std::max(tmin.y, tmin.z)));
+		float tFar = std::min(tMax, std::min(tmax.x, std::min(tmax.y, tmax.z)));
+
+		return tFar >= tNear;
+	}
+
+	float ClosestHitStack(const Model& model, const Ray& r)
+	{
+		glm::vec3 invDir = 1.0f / r.dir;
+		float tNear = NO_HIT;
+
+		int stack[64];
+		int ptr = 0;
+		stack[ptr++] = -1;
+		stack[ptr] = 0;
+
+		do
+		{
+			int idx = stack[ptr--];
+			const GPUBVHNode& node = model.nodes[idx];
+
+			if (node.nPrimitives > 0)
+			{
+				for (uint32_t j = 0; j < node.nPrimitives; ++j)
+					tNear = std::min(tNear, IntersectTriangle(model.triangles[node.secondChildOffset + j], r));
+			}
+			else
+			{
+				int second = int(node.secondChildOffset);
+				float tLeft	 = IntersectAABB(model.nodes[idx + 1], invDir, r);
+				float tRight = IntersectAABB(model.nodes[second], invDir, r);
+
+				if (tLeft > 0.0f && tRight > 0.0f)
+				{
+					if (tLeft < tRight)
+					{
+						stack[++ptr] = second;
+						stack[++ptr] = idx + 1;
+					}
+					else
+					{
+						stack[++ptr] = idx + 1;
+						stack[++ptr] = second;
+					}
+				}
+				else if (tLeft > 0.0f)
+					stack[++ptr] = idx + 1;
+				else if (tRight > 0.0f)
+					stack[++ptr] = second;
+			}
+		} while (ptr > 0);
+
+		return tNear;
+	}
+
+	bool AnyHitStack(const Model& model, const Ray& r, const float& maxDist)
+	{
+		glm::vec3 invDir = 1.0f / r.dir;
+		if (!OverlapAABB(model.nodes[0], invDir, r, EPSILON, maxDist))
+			return false;
+
+		int stack[64];
+		int ptr = 0;
+		stack[ptr++] = -1;
+		stack[ptr] = 0;
+
+		do
+		{
+			int idx = stack[ptr--];
+			const GPUBVHNode& node = model.nodes[idx];
+
+			if (node.nPrimitives > 0)
+			{
+				for (uint32_t j = 0; j < node.nPrimitives; ++j)
+				{
+					float t = IntersectTriangle(model.triangles[node.secondChildOffset + j], r);
+					if (t > EPSILON && t < maxDist)
+						return true;
+				}
+			}
+			else
+			{
+				if (OverlapAABB(model.nodes[idx + 1], invDir, r, EPSILON, maxDist))
+					stack[++ptr] = idx + 1;
+				if (OverlapAABB(model.nodes[node.secondChildOffset], invDir, r, EPSILON, maxDist))
+					stack[++ptr] = int(node.secondChildOffset);
+			}
+		} while (ptr > 0);
+
+		return false;
+	}
+
+	float ClosestHitStackless(const Model& model, const Ray& r)
+	{
+		glm::vec3 invDir = 1.0f / r.dir;
+		float tNear = NO_HIT;
+
+		uint32_t idx = 0;
+		uint32_t end = model.nodes[0].escapeOffset;
+		while (idx < end)
+		{
+			const GPUBVHNode& node = model.nodes[idx];
+			if (!OverlapAABB(node, invDir, r, 0.0f, tNear))
+			{
+				idx = node.escapeOffset;
+				continue;
+			}
+
+			if (node.nPrimitives > 0)
+			{
+				for (uint32_t j = 0; j < node.nPrimitives; ++j)
+					tNear = std::min(tNear, IntersectTriangle(model.triangles[node.secondChildOffset + j], r));
+				idx = node.escapeOffset;
+			}
+			else
+				idx = idx + 1;
+		}
+
+		return tNear;
+	}
+
+	bool AnyHitStackless(const Model& model, const Ray& r, const float& maxDist)
+	{
+		glm::vec3 invDir = 1.0f / r.dir;
+
+		uint32_t idx = 0;
+		uint32_t end = model.nodes[0].escapeOffset;
+		while (idx < end)
+		{
+			const GPUBVHNode& node = model.nodes[idx];
+			if (!OverlapAABB(node, invDir, r, EPSILON, maxDist))
+			{
+				idx = node.escapeOffset;
+				continue;
+			}
+
+			if (node.nPrimitives > 0)
+			{
+				for (uint32_t j = 0; j < node.nPrimitives; ++j)
+				{
+					float t = IntersectTriangle(model.triangles[node.secondChildOffset + j], r);
+					if (t > EPSILON && t < maxDist)
+						return true;
+				}
+				idx = node.escapeOffset;
+			}
+			else
+				idx = idx + 1;
+		}
+
+		return false;
+	}
+
+	float ClosestHitBruteForce(const Model& model, const Ray& r)
+	{
+		float tNear = NO_HIT;
+		for (const Triangle& triangle : model.triangles)
+			tNear = std::min(tNear, IntersectTriangle(triangle, r));
+		return tNear;
+	}
+
+	bool AnyHitBruteForce(const Model& model, const Ray& r, const float& maxDist)
+	{
+		for (const Triangle& triangle : model.triangles)
+		{
+			float t = IntersectTriangle(triangle, r);
+			if (t > EPSILON && t < maxDist)
+				return true;
+		}
+		return false;
+	}
+
+	Model BuildModel(const std::vector<Triangle>& triangles)
+	{
+		std::vector<Primitive> primitives(triangles.size());
+		for (uint32_t i = 0; i < triangles.size(); ++i)
+		{
+			primitives[i].bounds.min = glm::min(triangles[i][0], glm::min(triangles[i][1], triangles[i][2]));
+			primitives[i].bounds.max = glm::max(triangles[i][0], glm::max(triangles[i][1], triangles[i][2]));
+			primitives[i].centroid = 0.5f * (primitives[i].bounds.min + primitives[i].bounds.max);
+			primitives[i].index = i;
+		}
+
+		Model model;
+		std::vector<const Primitive*> order;
+		BuildFlatBVH(primitives, model.nodes, order);
+		for (const Primitive* primitive : order)
+			model.triangles.push_back(triangles[primitive->index]);
+		return model;
+	}
+
+	// Every subtree is contiguous in preorder and its escape link points right past it
+	bool HasValidEscapeLinks(const Model& model)
+	{
+		if (model.nodes[0].escapeOffset != model.nodes.size())
+			return false;
+
+		for (uint32_t idx = 0; idx < model.nodes.size(); ++idx)
+		{
+			const GPUBVHNode& node = model.nodes[idx];
+			if (node.escapeOffset <= idx || node.escapeOffset > model.nodes.size())
+				return false;
+
+			if (node.nPrimitives > 0)
+			{
+				if (node.escapeOffset != idx + 1 || node.secondChildOffset + node.nPrimitives > model.triangles.size())
+					return false;
+			}
+			else
+			{
+				const GPUBVHNode& left = model.nodes[idx + 1];
+				const GPUBVHNode& right = model.nodes[node.secondChildOffset];
+				if (left.escapeOffset != node.secondChildOffset || right.escapeOffset != node.escapeOffset)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	glm::vec3 RandomVec3(std::mt19937& rng, const float& lo, const float& hi)
+	{
+		std::uniform_real_distribution<float> u(lo, hi);
+		float x = u(rng), y = u(rng), z = u(rng);
+		return glm::vec3(x, y, z);
+	}
+
+	glm::vec3 RandomDirection(std::mt19937& rng)
+	{
+		glm::vec3 d;
+		do
+			d = RandomVec3(rng, -1.0f, 1.0f);
+		while (glm::dot(d, d) > 1.0f || glm::dot(d, d) < 1e-4f);
+		return glm::normalize(d);
+	}
+
+	// Small triangles scattered through the unit cube
+	std::vector<Triangle> TriangleSoup(std::mt19937& rng, const uint32_t& count)
+	{
+		std::vector<Triangle> triangles;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			glm::vec3 center = RandomVec3(rng, 0.0f, 1.0f);
+			triangles.push_back({ center + RandomVec3(rng, -0.05f, 0.05f), center + RandomVec3(rng, -0.05f, 0.05f), center + RandomVec3(rng, -0.05f, 0.05f) });
+		}
+		return triangles;
+	}
+
+	// A closed grid of quads over the faces of the unit cube, many triangles share edges and planes
+	std::vector<Triangle> TessellatedCube(const uint32_t& n)
+	{
+		std::vector<Triangle> triangles;
+		for (int axis = 0; axis < 3; ++axis)
+			for (float side : { 0.0f, 1.0f })
+				for (uint32_t i = 0; i < n; ++i)
+					for (uint32_t j = 0; j < n; ++j)
+					{
+						auto Corner = [&](const uint32_t& a, const uint32_t& b)
+						{
+							glm::vec3 p(0.0f);
+							p[axis] = side;
+							p[(axis + 1) % 3] = float(a) / float(n);
+							p[(axis + 2) % 3] = float(b) / float(n);
+							return p;
+						};
+						triangles.push_back({ Corner(i, j), Corner(i + 1, j), Corner(i + 1, j + 1) });
+						triangles.push_back({ Corner(i, j), Corner(i + 1, j + 1), Corner(i, j + 1) });
+					}
+		return triangles;
+	}
+
+	void CheckTraversals(const Model& model, std::mt19937& rng, const uint32_t& nRays)
+	{
+		// Broken links could send the stackless walks around in circles
+		bool validLinks = HasValidEscapeLinks(model);
+		CHECK(validLinks);
+		if (!validLinks)
+			return;
+
+		uint32_t closestMismatches = 0, anyMismatches = 0, hits = 0;
+		for (uint32_t i = 0; i < nRays; ++i)
+		{
+			// Origins inside and around the geometry, every other ray aimed into it
+			glm::vec3 origin = RandomVec3(rng, -0.5f, 1.5f);
+			glm::vec3 target = RandomVec3(rng, 0.0f, 1.0f);
+			Ray r{ origin, i % 2 == 0 ? RandomDirection(rng) : glm::normalize(target - origin) };
+			float reference = ClosestHitBruteForce(model, r);
+			hits += reference < NO_HIT;
+
+			if (ClosestHitStack(model, r) != reference || ClosestHitStackless(model, r) != reference)
+				++closestMismatches;
+
+			// Shadow segments ending before, at and past the closest hit
+			std::uniform_real_distribution<float> u(0.0f, 2.0f);
+			float maxDist = u(rng);
+			bool occluded = AnyHitBruteForce(model, r, maxDist);
+			if (AnyHitStack(model, r, maxDist) != occluded || AnyHitStackless(model, r, maxDist) != occluded)
+				++anyMismatches;
+		}
+
+		if (closestMismatches || anyMismatches)
+			std::fprintf(stderr, "%u closest hit and %u any hit mismatches over %u rays\n", closestMismatches, anyMismatches, nRays);
+		CHECK(closestMismatches == 0);
+		CHECK(anyMismatches == 0);
+
+		// Large models must actually exercise the hit paths
+		if (model.triangles.size() >= 1000)
+			CHECK(hits > nRays / 10);
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(7);
+
+	for (uint32_t count : { 1u, 2u, 3u, 17u, 1000u, 20000u })
+		CheckTraversals(BuildModel(TriangleSoup(rng, count)), rng, 4000);
+
+	CheckTraversals(BuildModel(TessellatedCube(16)), rng, 4000);
+
+	return TEST_RESULT();
+}
\ No newline at end of file
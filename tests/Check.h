@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+
+// Minimal checks for the CPU tests, a failed check reports where it failed and the test exits with failure
+namespace PT::Test
+{
+	inline int& Failures()
+	{
+		static int failures = 0;
+		return failures;
+	}
+}
+
+#define CHECK(expr)																		\
+	do																					\
+	{																					\
+		if (!(expr))																	\
+		{																				\
+			std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr);	\
+			++PT::Test::Failures();														\
+		}																				\
+	} while (0)
+
+#define TEST_RESULT() (PT::Test::Failures() == 0 ? EXIT_SUCCESS : EXIT_FAILURE)
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+
+// Just enough GLSL to compile the integer shader includes as C++ and test them on the CPU
+using uint = uint32_t;
+
+#define in
+#define inout
+
+struct vec2
+{
+	vec2(const float& t_x, const float& t_y) : x(t_x), y(t_y) {}
+	float x, y;
+};
+
+struct uvec3
+{
+	uvec3(const uint& t_x = 0, const uint& t_y = 0, const uint& t_z = 0) : x(t_x), y(t_y), z(t_z) {}
+	uint x, y, z;
+};
+
+inline uint bitfieldReverse(uint x)
+{
+	x = (x << 16u) | (x >> 16u);
+	x = ((x & 0x55555555u) << 1u) | ((x & 0xAAAAAAAAu) >> 1u);
+	x = ((x & 0x33333333u) << 2u) | ((x & 0xCCCCCCCCu) >> 2u);
+	x = ((x & 0x0F0F0F0Fu) << 4u) | ((x & 0xF0F0F0F0u) >> 4u);
+	x = ((x & 0x00FF00FFu) << 8u) | ((x & 0xFF00FF00u) >> 8u);
+	return x;
+}
\ No newline at end of file
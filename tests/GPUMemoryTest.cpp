@@ -0,0 +1,149 @@
+#include <PT.h>
+#include "GPUMemory.h"
+#include "Check.h"
+
+namespace
+{
+	using namespace PT;
+
+	constexpr size_t MB = 1024 * 1024;
+
+	size_t SubsystemTotal(const std::string& subsystem)
+	{
+		size_t total = 0;
+		for (const GPUAllocation& allocation : GPUMemory::GetAllocations())
+			if (allocation.subsystem == subsystem)
+				total += allocation.size;
+		return total;
+	}
+
+	// Unused capacity of the allocations that report how much they fill, as the breakdown sums it
+	size_t Wasted()
+	{
+		size_t wasted = 0;
+		for (const GPUAllocation& allocation : GPUMemory::GetAllocations())
+			if (allocation.used > 0)
+				wasted += allocation.size - allocation.used;
+		return wasted;
+	}
+
+	std::string CaptureBreakdown()
+	{
+		std::ostringstream output;
+		std::streambuf* previous = std::cout.rdbuf(output.rdbuf());
+		GPUMemory::LogBreakdown();
+		std::cout.rdbuf(previous);
+		return output.str();
+	}
+
+	void CheckTotals()
+	{
+		CHECK(GPUMemory::GetTotal() == 0);
+
+		uint32_t rays = GPUMemory::Allocate("Rays", "Wavefront", "SSBO", 8 * MB);
+		uint32_t hits = GPUMemory::Allocate("Hits", "Wavefront", "SSBO", 4 * MB);
+		uint32_t nodes = GPUMemory::Allocate("Nodes", "Scene", "SSBO", 3 * MB);
+		uint32_t accumulation = GPUMemory::Allocate("Accumulation", "Film", "Texture", 16 * MB);
+
+		CHECK(GPUMemory::GetTotal() == 31 * MB);
+		CHECK(GPUMemory::GetAllocations().size() == 4);
+		CHECK(SubsystemTotal("Wavefront") == 12 * MB);
+		CHECK(SubsystemTotal("Scene") == 3 * MB);
+		CHECK(SubsystemTotal("Film") == 16 * MB);
+
+		// The breakdown reports the same totals, per subsystem and overall
+		std::string breakdown = CaptureBreakdown();
+		CHECK(breakdown.find("GPU memory: 31.00 MB in 4 allocations") != std::string::npos);
+		CHECK(breakdown.find("  Wavefront: 12.00 MB") != std::string::npos);
+		CHECK(breakdown.find("  Scene: 3.00 MB") != std::string::npos);
+		CHECK(breakdown.find("  Film: 16.00 MB") != std::string::npos);
+
+		for (uint32_t id : { rays, hits, nodes, accumulation })
+			GPUMemory::Free(id);
+		CHECK(GPUMemory::GetTotal() == 0);
+	}
+
+	void CheckWaste()
+	{
+		uint32_t queue = GPUMemory::Allocate("Queue", "Wavefront", "SSBO", 10 * MB);
+		uint32_t vertices = GPUMemory::Allocate("Vertices", "Scene", "SSBO", 4 * MB);
+		uint32_t unreported = GPUMemory::Allocate("Lights", "Scene", "SSBO", 2 * MB);
+
+		// Mostly empty slabs are flagged, full ones and those that don't report usage are not
+		GPUMemory::SetUsed(queue, 2 * MB);
+		GPUMemory::SetUsed(vertices, 3 * MB);
+		CHECK(Wasted() == 9 * MB);
+
+		std::string breakdown = CaptureBreakdown();
+		CHECK(breakdown.find("Queue (SSBO): 10.00 MB, 2.00 MB used <- 80.00% unused") != std::string::npos);
+		CHECK(breakdown.find("Vertices (SSBO): 4.00 MB, 3.00 MB used\n") != std::string::npos);
+		CHECK(breakdown.find("Lights (SSBO): 2.00 MB\n") != std::string::npos);
+		CHECK(breakdown.find("Unused capacity of the allocations that report it: 9.00 MB") != std::string::npos);
+
+		// Usage is clamped to the allocation, a full one wastes nothing
+		GPUMemory::SetUsed(vertices, 5 * MB);
+		CHECK(Wasted() == 8 * MB);
+
+		// Usage no longer applies once the allocation is resized, until the owner reports it again
+		GPUMemory::Resize(queue, 4 * MB);
+		CHECK(Wasted() == 0);
+		CHECK(GPUMemory::GetTotal() == 10 * MB);
+		GPUMemory::SetUsed(queue, 3 * MB);
+		CHECK(Wasted() == 1 * MB);
+
+		for (uint32_t id : { queue, vertices, unreported })
+			GPUMemory::Free(id);
+		CHECK(GPUMemory::GetTotal() == 0);
+		CHECK(Wasted() == 0);
+	}
+
+	void CheckUnregistering()
+	{
+		uint32_t a = GPUMemory::Allocate("A", "Wavefront", "SSBO", 1 * MB);
+		uint32_t b = GPUMemory::Allocate("B", "Wavefront", "SSBO", 2 * MB);
+		uint32_t c = GPUMemory::Allocate("C", "Film", "Texture", 4 * MB);
+
+		// A reallocation replaces the size instead of adding a second entry
+		GPUMemory::Resize(b, 6 * MB);
+		CHECK(GPUMemory::GetTotal() == 11 * MB);
+		CHECK(GPUMemory::GetAllocations().size() == 3);
+		CHECK(SubsystemTotal("Wavefront") == 7 * MB);
+
+		// Freed entries leave the totals and the breakdown
+		GPUMemory::Free(b);
+		CHECK(GPUMemory::GetTotal() == 5 * MB);
+		CHECK(GPUMemory::GetAllocations().size() == 2);
+		CHECK(CaptureBreakdown().find("B (SSBO)") == std::string::npos);
+
+		// Stale ids are ignored, freeing twice or touching a freed entry changes nothing
+		GPUMemory::Free(b);
+		GPUMemory::Resize(b, 64 * MB);
+		GPUMemory::SetUsed(b, 1 * MB);
+		GPUMemory::Free(GPU_NO_ALLOCATION);
+		CHECK(GPUMemory::GetTotal() == 5 * MB);
+		CHECK(GPUMemory::GetAllocations().size() == 2);
+
+		// The freed slot is reused with none of the previous owner's state
+		uint32_t d = GPUMemory::Allocate("D", "Scene", "SSBO", 8 * MB);
+		CHECK(d == b);
+		std::vector<GPUAllocation> live = GPUMemory::GetAllocations();
+		auto entry = std::find_if(live.begin(), live.end(), [](const GPUAllocation& allocation) { return allocation.name == "D"; });
+		CHECK(entry != live.end() && entry->size == 8 * MB && entry->used == 0 && entry->subsystem == "Scene");
+		CHECK(SubsystemTotal("Wavefront") == 1 * MB);
+		CHECK(GPUMemory::GetTotal() == 13 * MB);
+
+		for (uint32_t id : { a, c, d })
+			GPUMemory::Free(id);
+		CHECK(GPUMemory::GetTotal() == 0);
+		CHECK(GPUMemory::GetAllocations().empty());
+	}
+}
+
+int main()
+{
+	CheckTotals();
+	CheckWaste();
+	CheckUnregistering();
+
+	return TEST_RESULT();
+}
\ No newline at end of file
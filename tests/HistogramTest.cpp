@@ -0,0 +1,129 @@
+#include <PT.h>
+#include <random>
+#include "Histogram.h"
+#include "Check.h"
+
+namespace
+{
+	using namespace PT;
+
+	// What the header promises for percentiles, relative to the exact order statistic
+	constexpr double MAX_RELATIVE_ERROR = 1.0 / 32.0;
+
+	double RelativeError(const double& value, const double& reference)
+	{
+		return std::abs(value - reference) / reference;
+	}
+
+	// The one based rank GetPercentile reports, over sorted samples
+	double ExactPercentile(const std::vector<double>& sorted, const double& p)
+	{
+		size_t rank = std::max<size_t>(1, size_t(std::ceil(p * 0.01 * double(sorted.size()))));
+		return sorted[rank - 1];
+	}
+
+	void CheckBucketBounds()
+	{
+		const double lowest = 1e-2, highest = 1e5;
+		Histogram histogram(lowest, highest);
+		const uint32_t last = histogram.GetBucketCount() - 1;
+
+		// Everything below the lowest trackable value, or not a number, lands in the first bucket
+		for (double value : { 0.0, -1.0, -std::numeric_limits<double>::infinity(), lowest * 0.999, std::numeric_limits<double>::quiet_NaN() })
+			CHECK(histogram.BucketIndex(value) == 0);
+		CHECK(histogram.BucketIndex(lowest) == 0);
+
+		// Everything above the highest lands in the last bucket
+		for (double value : { highest * 4.0, 1e300, std::numeric_limits<double>::max(), std::numeric_limits<double>::infinity() })
+			CHECK(histogram.BucketIndex(value) == last);
+		CHECK(histogram.BucketIndex(highest) <= last);
+
+		// Buckets grow with the value and report it within the relative error over the whole tracked range
+		uint32_t previous = 0;
+		bool monotonic = true, accurate = true;
+		for (double value = lowest; value <= highest; value *= 1.001)
+		{
+			uint32_t index = histogram.BucketIndex(value);
+			monotonic = monotonic && index >= previous && index <= last;
+			accurate = accurate && RelativeError(histogram.BucketValue(index), value) <= MAX_RELATIVE_ERROR;
+			previous = index;
+		}
+		CHECK(monotonic);
+		CHECK(accurate);
+
+		// Out of range values are still counted
+		histogram.Record(-5.0);
+		histogram.Record(1e9);
+		CHECK(histogram.GetCount() == 2);
+	}
+
+	void CheckPercentiles()
+	{
+		std::mt19937 rng(3);
+		std::lognormal_distribution<double> frameTimes(std::log(16.0), 0.5);
+		std::uniform_real_distribution<double> exponent(-2.0, 5.0);
+
+		for (int distribution = 0; distribution < 2; ++distribution)
+		{
+			Histogram histogram(1e-2, 1e5);
+			std::vector<double> samples;
+			for (int i = 0; i < 100000; ++i)
+			{
+				// Frame time like samples, then values spread over the whole tracked range
+				double value = distribution == 0 ? frameTimes(rng) : std::pow(10.0, exponent(rng));
+				samples.push_back(value);
+				histogram.Record(value);
+			}
+			std::sort(samples.begin(), samples.end());
+
+			for (double p : { 0.0, 0.1, 1.0, 10.0, 25.0, 50.0, 75.0, 90.0, 99.0, 99.9, 99.99, 100.0 })
+				CHECK(RelativeError(histogram.GetPercentile(p), ExactPercentile(samples, p)) <= MAX_RELATIVE_ERROR);
+
+			// The extremes and the mean are exact
+			CHECK(histogram.GetMin() == samples.front());
+			CHECK(histogram.GetMax() == samples.back());
+			double sum = 0.0;
+			for (double value : samples)
+				sum += value;
+			CHECK(RelativeError(histogram.GetMean(), sum / double(samples.size())) < 1e-9);
+			CHECK(histogram.GetCount() == samples.size());
+		}
+	}
+
+	void CheckMaxTracking()
+	{
+		Histogram histogram(1e-2, 1e5);
+		CHECK(histogram.GetPercentile(50.0) == 0.0);
+		CHECK(histogram.GetMax() == 0.0);
+
+		// A single spike keeps the maximum exact even past the tracked range, percentiles never exceed it
+		for (int i = 0; i < 1000; ++i)
+			histogram.Record(10.0);
+		histogram.Record(2e6);
+		CHECK(histogram.GetMax() == 2e6);
+		CHECK(histogram.GetPercentile(100.0) <= histogram.GetMax());
+		CHECK(RelativeError(histogram.GetPercentile(99.0), 10.0) <= MAX_RELATIVE_ERROR);
+
+		// Percentiles are clamped to the recorded range, a single value is reported exactly
+		Histogram single(1e-2, 1e5);
+		single.Record(3.3);
+		CHECK(single.GetPercentile(0.0) == 3.3);
+		CHECK(single.GetPercentile(100.0) == 3.3);
+
+		// Reset forgets the previous maximum
+		histogram.Reset();
+		CHECK(histogram.GetCount() == 0);
+		histogram.Record(1.0);
+		CHECK(histogram.GetMax() == 1.0);
+		CHECK(histogram.GetMin() == 1.0);
+	}
+}
+
+int main()
+{
+	CheckBucketBounds();
+	CheckPercentiles();
+	CheckMaxTracking();
+
+	return TEST_RESULT();
+}
\ No newline at end of file
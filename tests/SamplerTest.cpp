@@ -0,0 +1,185 @@
+#include <cmath>
+#include <vector>
+#include "Check.h"
+#include "GLSL.h"
+
+// The shader keeps the sampler state in globals.glsl
+static uvec3 samplerState;
+#include "../src/shaders/include/sampler.glsl"
+
+#undef in
+#undef inout
+
+namespace
+{
+	// The PCG4D generator the sampler replaced, kept as the reference for the convergence check
+	struct PCG4D
+	{
+		PCG4D(const uint& pixel, const uint& sampleIndex, const uint& dimension) : v{ pixel, sampleIndex, dimension, 0u } {}
+
+		void Next()
+		{
+			for (uint& c : v)
+				c = c * 1664525u + 1013904223u;
+			v[0] += v[1] * v[3]; v[1] += v[2] * v[0]; v[2] += v[0] * v[1]; v[3] += v[1] * v[2];
+			for (uint& c : v)
+				c ^= c >> 16u;
+			v[0] += v[1] * v[3]; v[1] += v[2] * v[0]; v[2] += v[0] * v[1]; v[3] += v[1] * v[2];
+		}
+
+		vec2 Rand2()
+		{
+			Next();
+			return vec2(float(v[0]) / float(0xffffffffu), float(v[1]) / float(0xffffffffu));
+		}
+
+		uint v[4];
+	};
+
+	vec2 Sobol2D(const uint& pixel, const uint& sampleIndex, const uint& dimension)
+	{
+		InitSampler(pixel, sampleIndex, dimension);
+		return Sample2D(0);
+	}
+
+	// Every elementary interval of a 2^m x 2^(k-m) grid holds exactly one of the first 2^k points
+	bool IsNet(const uint& pixel, const uint& dimension, const uint& k)
+	{
+		const uint n = 1u << k;
+		for (uint m = 0; m <= k; ++m)
+		{
+			std::vector<uint> cells(n, 0);
+			for (uint i = 0; i < n; ++i)
+			{
+				vec2 p = Sobol2D(pixel, i, dimension);
+				if (p.x < 0.0f || p.x >= 1.0f || p.y < 0.0f || p.y >= 1.0f)
+					return false;
+
+				uint cx = uint(p.x * float(1u << m));
+				uint cy = uint(p.y * float(1u << (k - m)));
+				++cells[(cy << m) | cx];
+			}
+
+			for (uint c : cells)
+				if (c != 1)
+					return false;
+		}
+		return true;
+	}
+
+	bool IsStratified1D(const uint& pixel, const uint& dimension, const uint& k)
+	{
+		const uint n = 1u << k;
+		std::vector<uint> cells(n, 0);
+		for (uint i = 0; i < n; ++i)
+		{
+			InitSampler(pixel, i, dimension);
+			++cells[uint(Sample1D(0) * float(n))];
+		}
+
+		for (uint c : cells)
+			if (c != 1)
+				return false;
+		return true;
+	}
+
+	// Quarter disk coverage, the discontinuity stands in for the geometric edges a pixel integrates over
+	double Integrand(const vec2& p)
+	{
+		return p.x * p.x + p.y * p.y < 1.0f ? 1.0 : 0.0;
+	}
+
+	// RMS error of the per pixel estimates of the integral over a number of pixels
+	template<typename Estimator>
+	double RMSError(const uint& samples, Estimator&& estimate)
+	{
+		const uint pixels = 1024;
+		const double reference = 3.14159265358979323846 / 4.0;
+
+		double sum = 0.0;
+		for (uint pixel = 0; pixel < pixels; ++pixel)
+		{
+			double e = estimate(pixel, samples) - reference;
+			sum += e * e;
+		}
+		return std::sqrt(sum / pixels);
+	}
+
+	double EstimateSobol(const uint& pixel, const uint& samples)
+	{
+		double sum = 0.0;
+		for (uint i = 0; i < samples; ++i)
+			sum += Integrand(Sobol2D(pixel, i, DIM_BOUNCE + DIM_BSDF));
+		return sum / samples;
+	}
+
+	double EstimatePCG(const uint& pixel, const uint& samples)
+	{
+		double sum = 0.0;
+		for (uint i = 0; i < samples; ++i)
+			sum += Integrand(PCG4D(pixel, i, 0u).Rand2());
+		return sum / samples;
+	}
+}
+
+int main()
+{
+	// The index shuffle and the Owen scramble map each aligned block of bit patterns one to one onto another
+	{
+		std::vector<bool> seen(1u << 16, false);
+		bool bijective = true;
+		for (uint x = 0; x < (1u << 16); ++x)
+		{
+			uint y = NestedUniformScramble(x, 0x9e3779b9u);
+			bijective = bijective && (y >> 16u) == (NestedUniformScramble(0u, 0x9e3779b9u) >> 16u) && !seen[y & 0xffffu];
+			seen[y & 0xffffu] = true;
+		}
+		CHECK(bijective);
+	}
+
+	// The first two Sobol dimensions as generated here
+	CHECK(SobolSecondDimension(0) == 0u);
+	CHECK(SobolSecondDimension(1) == 0x80000000u);
+	CHECK(SobolSecondDimension(2) == 0xc0000000u);
+	CHECK(SobolSecondDimension(3) == 0x40000000u);
+	CHECK(ToUnitFloat(0xffffffffu) < 1.0f);
+
+	// Scrambling keeps the (0, 2) sequence property, every power of two prefix is a (0, k, 2)-net
+	for (uint pixel : { 0u, 1u, 12345u, 0xfffffu })
+		for (uint dimension : { uint(DIM_CAMERA), uint(DIM_BOUNCE + DIM_BSDF), uint(DIM_BOUNCE + 7 * DIMS_PER_BOUNCE + DIM_LIGHT) })
+			for (uint k = 0; k <= 10; ++k)
+			{
+				CHECK(IsNet(pixel, dimension, k));
+				CHECK(IsStratified1D(pixel, dimension, k));
+			}
+
+	// Pixels and dimensions draw differently scrambled points
+	{
+		vec2 a = Sobol2D(7, 3, DIM_CAMERA);
+		vec2 b = Sobol2D(8, 3, DIM_CAMERA);
+		vec2 c = Sobol2D(7, 3, DIM_BOUNCE + DIM_BSDF);
+		CHECK(a.x != b.x || a.y != b.y);
+		CHECK(a.x != c.x || a.y != c.y);
+	}
+
+	// Convergence against the old sampler, the error of scrambled Sobol falls faster than the N^-1/2 of PCG4D
+	std::printf("samples  sobol rmse  pcg4d rmse\n");
+	double sobolFirst = 0.0, sobolLast = 0.0, pcgLast = 0.0;
+	for (uint samples = 4; samples <= 1024; samples *= 4)
+	{
+		double sobol = RMSError(samples, EstimateSobol);
+		double pcg = RMSError(samples, EstimatePCG);
+		std::printf("%7u  %10.6f  %10.6f\n", samples, sobol, pcg);
+
+		if (samples == 4)
+			sobolFirst = sobol;
+		sobolLast = sobol;
+		pcgLast = pcg;
+	}
+	CHECK(sobolLast < 0.3 * pcgLast);
+
+	// Quarter disk edges converge at about N^-3/4, allow some slack below that over the 256x sample range
+	CHECK(sobolFirst / sobolLast > std::pow(256.0, 0.65));
+
+	return TEST_RESULT();
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+// Stand-in for src/pch/PT.h with only the standard library and glm, for tests that compile GL free sources
+#include <cstdint>
+#include <cmath>
+#include <iostream>
+#include <functional>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include <cstring>
+
+#include <vector>
+#include <array>
+#include <stack>
+#include <map>
+#include <string>
+#include <sstream>
+
+// Only the sources that use glm need it
+#if __has_include(<glm/glm.hpp>)
+#include <glm/glm.hpp>
+#endif
\ No newline at end of file